@@ -0,0 +1,204 @@
+//
+//  BatchDecoder.cpp
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "BatchDecoder.h"
+#include <stun/BufferReader.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#endif
+
+STUN_BEGIN
+
+BatchDecoder::BatchDecoder()
+: _count(0)
+, _valid(0)
+{
+    
+}
+
+BatchDecoder::~BatchDecoder()
+{
+    
+}
+
+size_t BatchDecoder::decode(const network::BufferView* datagrams, size_t n)
+{
+    n = std::min<size_t>(n, MAX_BATCH_MESSAGES);
+    _count = n;
+    
+    // Gather first 32 bits of headers, and sizes of datagrams
+    // A datagram shorter than a header gets a word that fails the checks
+    uint32_t words[MAX_BATCH_MESSAGES] = { 0 };
+    uint32_t sizes[MAX_BATCH_MESSAGES] = { 0 };
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t size = datagrams[i].readable();
+        words[i] = size >= MESSAGE_HEADER_LENGTH ? network::loadBE32(datagrams[i].read()) : 0xFFFFFFFF;
+        sizes[i] = static_cast<uint32_t>(std::min<size_t>(size, 0xFFFFFFFF));
+    }
+    _valid = validateHeaders(words, sizes, n);
+    
+    memset(_types, 0, n * sizeof(_types[0]));
+    memset(_mapped, 0, n * sizeof(_mapped[0]));
+    memset(_changed, 0, n * sizeof(_changed[0]));
+    memset(_errors, 0, n * sizeof(_errors[0]));
+    memset(_tids, 0, n * sizeof(_tids[0]));
+    
+    // Attributes of valid messages
+    size_t count = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(!valid(i))
+        {
+            continue;
+        }
+        
+        const unsigned char* b = datagrams[i].read();
+        _types[i] = static_cast<unsigned short>(words[i] >> 16);
+        memcpy(_tids[i], b + 4, 16);
+        if(decodeAttributes(i, b, sizes[i]))
+        {
+            ++count;
+        }
+        else
+        {
+            _valid &= ~(static_cast<uint64_t>(1) << i);
+            _types[i] = 0;
+            memset(_tids[i], 0, sizeof(_tids[i]));
+            memset(&_mapped[i], 0, sizeof(_mapped[i]));
+            memset(&_changed[i], 0, sizeof(_changed[i]));
+            _errors[i] = 0;
+        }
+    }
+    return count;
+}
+
+/*
+ First 32 bits of header are message type and length
+ Top two bits of type are zero, length is a multiple of 4 and covers
+ the rest of datagram exactly, and type is a binding message
+ */
+
+#define HEADER_ZERO_BITS 0xC0000003
+
+static inline bool isBindingType(uint32_t type)
+{
+    return type == MT_BINDING_RESPONSE || type == MT_BINDING_ERROR_RESPONSE || type == MT_BINDING_REQUEST;
+}
+
+uint64_t BatchDecoder::validateHeaders(const uint32_t* words, const uint32_t* sizes, size_t n)
+{
+    uint64_t valid = 0;
+    size_t i = 0;
+    
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i zeroBits = _mm_set1_epi32(HEADER_ZERO_BITS);
+    const __m128i typeBits = _mm_set1_epi32(0xFFFF0000);
+    const __m128i lengthBits = _mm_set1_epi32(0x0000FFFF);
+    const __m128i header = _mm_set1_epi32(MESSAGE_HEADER_LENGTH);
+    const __m128i response = _mm_set1_epi32(MT_BINDING_RESPONSE << 16);
+    const __m128i error = _mm_set1_epi32(MT_BINDING_ERROR_RESPONSE << 16);
+    const __m128i request = _mm_set1_epi32(MT_BINDING_REQUEST << 16);
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sizes + i));
+        
+        __m128i ok = _mm_cmpeq_epi32(_mm_and_si128(w, zeroBits), _mm_setzero_si128());
+        ok = _mm_and_si128(ok, _mm_cmpeq_epi32(_mm_add_epi32(_mm_and_si128(w, lengthBits), header), s));
+        
+        __m128i type = _mm_and_si128(w, typeBits);
+        __m128i known = _mm_or_si128(_mm_cmpeq_epi32(type, response),
+                                     _mm_or_si128(_mm_cmpeq_epi32(type, error), _mm_cmpeq_epi32(type, request)));
+        ok = _mm_and_si128(ok, known);
+        
+        valid |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(ok))) << i;
+    }
+#endif
+    
+    for(; i < n; ++i)
+    {
+        uint32_t w = words[i];
+        bool ok = (w & HEADER_ZERO_BITS) == 0
+               && (w & 0xFFFF) + MESSAGE_HEADER_LENGTH == sizes[i]
+               && isBindingType(w >> 16);
+        valid |= static_cast<uint64_t>(ok) << i;
+    }
+    return valid;
+}
+
+// Walk attributes of a valid message, false if malformed
+bool BatchDecoder::decodeAttributes(size_t i, const unsigned char* b, size_t n)
+{
+    bool xorMapped = false;
+    network::BufferReader r(b + MESSAGE_HEADER_LENGTH, n - MESSAGE_HEADER_LENGTH);
+    while(r.readable() > 0)
+    {
+        if(!r.require(ATTRIBUTE_HEADER_LENGTH))
+        {
+            return false;
+        }
+        
+        unsigned short type = r.getBE16();
+        size_t length = r.getBE16();
+        network::BufferView value = r.view(length);
+        if(r.failed() || !r.skip(ATTRIBUTE_PADDED_LENGTH(length) - length))
+        {
+            return false;
+        }
+        
+        // Attributes after MESSAGE-INTEGRITY are ignored (RFC 5389 15.4)
+        if(type == AT_MESSAGE_INTEGRITY)
+        {
+            break;
+        }
+        
+        switch(type)
+        {
+            case AT_MAPPED_ADDRESS:
+                if(!xorMapped)
+                {
+                    AddressAttribute::parse(&value, &_mapped[i]);
+                }
+                break;
+                
+            case AT_XOR_MAPPED_ADDRESS:
+            {
+                sockaddr_storage ss;
+                if(XorAddressAttribute::parse(&value, _tids[i], &ss) && ss.ss_family == AF_INET)
+                {
+                    memcpy(&_mapped[i], &ss, sizeof(sockaddr_in));
+                    xorMapped = true;
+                }
+                break;
+            }
+                
+            case AT_CHANGED_ADDRESS:
+                AddressAttribute::parse(&value, &_changed[i]);
+                break;
+                
+            case AT_ERROR_CODE:
+            {
+                int code;
+                network::StringView reason;
+                if(ErrorCodeAttribute::parse(&value, &code, &reason))
+                {
+                    _errors[i] = static_cast<unsigned short>(code);
+                }
+                break;
+            }
+                
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+STUN_END
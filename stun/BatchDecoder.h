@@ -0,0 +1,120 @@
+//
+//  BatchDecoder.h
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef STUN_BATCH_DECODER_H
+#define STUN_BATCH_DECODER_H
+
+#include <stun/Config.h>
+#include <stun/Message.h>
+
+STUN_BEGIN
+
+/*
+ Decode a batch of received datagrams (a recvmmsg batch) at once
+ 
+ Results are kept as parallel arrays indexed by datagram, with a bit
+ per datagram telling if it is a well formed binding message (request,
+ response or error response, see types()). Headers of all datagrams
+ are validated first, 4 at a time with SIMD, then attributes of valid
+ ones are walked without allocation.
+ 
+ At most MAX_BATCH_MESSAGES datagrams are decoded by a call, count()
+ tells how many, so a longer batch is decoded in chunks:
+ 
+ stun::BatchDecoder batch;
+ for(size_t done = 0; done < n; done += batch.count())
+ {
+     batch.decode(datagrams + done, n - done);
+     for(size_t i = 0; i < batch.count(); ++i)
+     {
+         if(batch.valid(i) && batch.types()[i] == MT_BINDING_RESPONSE)
+         {
+             match(batch.tid(i), batch.mappedAddresses()[i]);
+         }
+     }
+ }
+ */
+
+#define MAX_BATCH_MESSAGES 64
+
+class BatchDecoder
+{
+public:
+    BatchDecoder();
+    ~BatchDecoder();
+    
+    // Decode the first MAX_BATCH_MESSAGES datagrams at most, see count()
+    // Returns number of valid messages
+    size_t decode(const network::BufferView* datagrams, size_t n);
+    
+    // Number of datagrams decoded by last call
+    size_t count() const
+    {
+        return _count;
+    }
+    
+    // Bit i is set if datagram i is a valid message
+    uint64_t validity() const
+    {
+        return _valid;
+    }
+    
+    bool valid(size_t i) const
+    {
+        return ((_valid >> i) & 1) != 0;
+    }
+    
+    network::UUID tid(size_t i) const
+    {
+        return network::UUID(_tids[i], 16);
+    }
+    
+    //
+    // Parallel arrays, of count() items
+    // Items of invalid datagrams are zero, as are addresses (AF_UNSPEC)
+    // and error codes of valid ones not present
+    //
+    
+    const unsigned short* types() const
+    {
+        return _types;
+    }
+    
+    const sockaddr_in* mappedAddresses() const // XOR-MAPPED-ADDRESS first
+    {
+        return _mapped;
+    }
+    
+    const sockaddr_in* changedAddresses() const
+    {
+        return _changed;
+    }
+    
+    const unsigned short* errorCodes() const
+    {
+        return _errors;
+    }
+    
+private:
+    size_t _count;
+    uint64_t _valid;
+    
+    unsigned short _types[MAX_BATCH_MESSAGES];
+    unsigned char _tids[MAX_BATCH_MESSAGES][16];
+    sockaddr_in _mapped[MAX_BATCH_MESSAGES];
+    sockaddr_in _changed[MAX_BATCH_MESSAGES];
+    unsigned short _errors[MAX_BATCH_MESSAGES];
+    
+    // Header checks of n messages, bit per message
+    static uint64_t validateHeaders(const uint32_t* words, const uint32_t* sizes, size_t n);
+    
+    bool decodeAttributes(size_t i, const unsigned char* b, size_t n);
+};
+
+STUN_END
+
+#endif
@@ -0,0 +1,68 @@
+//
+//  BindingTemplate.cpp
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "BindingTemplate.h"
+
+STUN_BEGIN
+
+/*
+ Wire images, transaction ID left zero
+ Binding request with no attribute, and with CHANGE-REQUEST
+ where flags are at the last byte: 0x04 change IP, 0x02 change port
+ */
+
+static const unsigned char BINDING_REQUEST[MESSAGE_HEADER_LENGTH] =
+{
+    0x00, 0x01, 0x00, 0x00,                         // Type, Length
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // Transaction ID
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static const unsigned char BINDING_CHANGE_REQUEST[BINDING_TEMPLATE_SIZE] =
+{
+    0x00, 0x01, 0x00, 0x08,                         // Type, Length
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // Transaction ID
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x03, 0x00, 0x04,                         // CHANGE-REQUEST
+    0x00, 0x00, 0x00, 0x00                          // Flags
+};
+
+#define TEMPLATE_TID_OFFSET 4
+#define TEMPLATE_FLAGS_OFFSET (BINDING_TEMPLATE_SIZE - 1)
+
+BindingTemplate::BindingTemplate(bool portChange, bool ipChange)
+{
+    if(portChange || ipChange)
+    {
+        memcpy(_data, BINDING_CHANGE_REQUEST, sizeof(BINDING_CHANGE_REQUEST));
+        _data[TEMPLATE_FLAGS_OFFSET] = (portChange ? 0x02 : 0) | (ipChange ? 0x04 : 0);
+        _size = sizeof(BINDING_CHANGE_REQUEST);
+    }
+    else
+    {
+        memcpy(_data, BINDING_REQUEST, sizeof(BINDING_REQUEST));
+        _size = sizeof(BINDING_REQUEST);
+    }
+}
+
+BindingTemplate::~BindingTemplate()
+{
+    
+}
+
+void BindingTemplate::setTid(const network::UUID& tid)
+{
+    assert(tid.size() == 16);
+    memcpy(_data + TEMPLATE_TID_OFFSET, tid.bytes(), 16);
+}
+
+network::UUID BindingTemplate::tid() const
+{
+    return network::UUID(_data + TEMPLATE_TID_OFFSET, 16);
+}
+
+STUN_END
@@ -0,0 +1,60 @@
+//
+//  BindingTemplate.h
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef STUN_BINDING_TEMPLATE_H
+#define STUN_BINDING_TEMPLATE_H
+
+#include <stun/Config.h>
+#include <stun/Message.h>
+
+STUN_BEGIN
+
+/*
+ Encoded binding request
+ 
+ Discovery only sends binding requests with no attribute, or with a
+ CHANGE-REQUEST attribute. The wire image of each shape is a constant,
+ so a request is made by copying the image and patching the transaction
+ ID in place, with no attribute object and no serializing. The bytes are
+ encoded once and sent as is on every retransmit:
+ 
+ BindingTemplate request(true); // Change port
+ request.setTid(stun::Message::newTid());
+ socket.write(request.data(), request.size());
+ */
+
+#define BINDING_TEMPLATE_SIZE (MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + 4)
+
+class BindingTemplate
+{
+public:
+    BindingTemplate(bool portChange = false, bool ipChange = false);
+    ~BindingTemplate();
+    
+    // Patch transaction ID in place
+    void setTid(const network::UUID& tid);
+    network::UUID tid() const;
+    
+    // Encoded message
+    const unsigned char* data() const
+    {
+        return _data;
+    }
+    
+    size_t size() const
+    {
+        return _size;
+    }
+    
+private:
+    unsigned char _data[BINDING_TEMPLATE_SIZE];
+    size_t _size;
+};
+
+STUN_END
+
+#endif
@@ -7,34 +7,188 @@
 //
 
 #include "Buffer.h"
+#include "Delimiter.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
 
 NETWORK_BEGIN
 
+// Uninitialized memory block, no zero fill
+static unsigned char* allocate(size_t n)
+{
+    unsigned char* p = static_cast<unsigned char*>(malloc(std::max(n, (size_t)1)));
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
 // limit is max size
 // 0 is no limit
 // Note: this limit include the bytes before read index
 Buffer::Buffer(size_t limit)
-: _v(1024)
+: _data(NULL)
+, _capacity(limit > 0 ? std::min(limit, (size_t)1024) : 1024)
+, _owned(true)
+, _ring(false)
 , _max_size(limit)
 , _read_index(0)
 , _write_index(0)
 {
-    
+    _data = allocate(_capacity);
 }
 
 Buffer::Buffer(const unsigned char* b, size_t n)
-: _v(2 * n)
+: _data(NULL)
+, _capacity(2 * n)
+, _owned(true)
+, _ring(false)
 , _max_size(0)
 , _read_index(0)
 , _write_index(0)
 {
-    memcpy(&_v[0], b, n);
+    _data = allocate(_capacity);
+    if(n > 0)
+    {
+        memcpy(_data, b, n);
+    }
     _write_index = n;
 }
 
+Buffer::Buffer(const Buffer& other)
+: _data(NULL)
+, _capacity(other.size())
+, _owned(true)
+, _ring(false)
+, _max_size(other._max_size)
+, _read_index(0)
+, _write_index(0)
+{
+    _data = allocate(_capacity);
+    if(other.readable() > 0)
+    {
+        memcpy(_data, other.read(), other.readable());
+    }
+    _write_index = other.readable();
+}
+
+Buffer::Buffer(unsigned char* data, size_t n, size_t limit)
+: _data(data)
+, _capacity(n)
+, _owned(false)
+, _ring(false)
+, _max_size(limit)
+, _read_index(0)
+, _write_index(0)
+{
+    
+}
+
+// Copy readable bytes into this memory, growing it if needed
+// Memory that can not grow (attached, ring or max size) keeps what fits
+Buffer& Buffer::operator=(const Buffer& other)
+{
+    if(this != &other)
+    {
+        clear();
+        size_t n = std::min(reserve(other.readable()), other.readable());
+        if(n > 0)
+        {
+            writeBlob(other.read(), n);
+        }
+    }
+    return *this;
+}
+
+void Buffer::swap(Buffer& b)
+{
+    if(_owned && b._owned)
+    {
+        std::swap(_data, b._data);
+        std::swap(_capacity, b._capacity);
+        std::swap(_read_index, b._read_index);
+        std::swap(_write_index, b._write_index);
+        std::swap(_max_size, b._max_size);
+    }
+    else
+    {
+        Buffer t(*this);
+        *this = b;
+        b = t;
+    }
+}
+
 Buffer::~Buffer()
 {
+    if(_owned)
+    {
+        free(_data);
+    }
+}
+
+void Buffer::attach(unsigned char* data, size_t n, bool ring)
+{
+    if(_owned)
+    {
+        free(_data);
+    }
     
+    _data = data;
+    _capacity = n;
+    _owned = false;
+    _ring = ring;
+    _read_index = 0;
+    _write_index = 0;
+}
+
+// Slow path of reserve()
+// Slide readable bytes to front if that makes enough room,
+// otherwise grow to double size but no more than max size
+// Memory not owned is left to its owner once the buffer grows
+size_t Buffer::expand(size_t n)
+{
+    if(_ring)
+    {
+        return writable();
+    }
+    
+    size_t count = readable();
+    size_t capacity = _capacity;
+    if(capacity - count < n)
+    {
+        capacity = std::max(capacity * 2, count + n);
+        if(_max_size > 0 && capacity > _max_size)
+        {
+            capacity = std::max(_max_size, _capacity);
+        }
+    }
+    
+    if(capacity > _capacity)
+    {
+        unsigned char* data = allocate(capacity);
+        if(count > 0)
+        {
+            memcpy(data, read(), count);
+        }
+        if(_owned)
+        {
+            free(_data);
+        }
+        _data = data;
+        _capacity = capacity;
+        _owned = true;
+    }
+    else if(_read_index > 0 && count > 0)
+    {
+        memmove(_data, read(), count);
+    }
+    
+    _read_index = 0;
+    _write_index = count;
+    return writable();
 }
 
 // Output data to socket
@@ -303,6 +457,49 @@ size_t Buffer::writeBlob(const unsigned char* b, size_t n)
     return n;
 }
 
+// Write in network byte order
+size_t Buffer::writeBE16(uint16_t v)
+{
+    assert(writable() >= sizeof(v));
+    storeBE16(write(), v);
+    write(sizeof(v));
+    return sizeof(v);
+}
+
+size_t Buffer::writeBE32(uint32_t v)
+{
+    assert(writable() >= sizeof(v));
+    storeBE32(write(), v);
+    write(sizeof(v));
+    return sizeof(v);
+}
+
+size_t Buffer::writeBE64(uint64_t v)
+{
+    assert(writable() >= sizeof(v));
+    storeBE64(write(), v);
+    write(sizeof(v));
+    return sizeof(v);
+}
+
+size_t Buffer::writeBE16Array(const uint16_t* v, size_t n)
+{
+    size_t len = n * sizeof(uint16_t);
+    assert(writable() >= len);
+    storeBE16Array(write(), v, n);
+    write(len);
+    return len;
+}
+
+size_t Buffer::writeBE32Array(const uint32_t* v, size_t n)
+{
+    size_t len = n * sizeof(uint32_t);
+    assert(writable() >= len);
+    storeBE32Array(write(), v, n);
+    write(len);
+    return len;
+}
+
 // Read particular data type
 int8_t Buffer::read8()
 {
@@ -449,52 +646,91 @@ bool Buffer::readString(std::string& s, size_t n)
 
 bool Buffer::readString(std::string& s, const char delim)
 {
-    if(readable() < sizeof(delim))
+    return readString(s, DelimiterSet(delim));
+}
+
+bool Buffer::readString(std::string& s, const std::string& delim)
+{
+    return readString(s, DelimiterSet(delim));
+}
+
+bool Buffer::readString(std::string& s, const DelimiterSet& delim)
+{
+    if(readable() < delim.length())
     {
         return false;
     }
     
     const char* p1 = reinterpret_cast<const char*>(read());
-    const char* p2 = std::find(p1, reinterpret_cast<const char*>(write()), delim);
+    const char* p2 = delim.find(p1, reinterpret_cast<const char*>(write()));
     if(p2 == reinterpret_cast<const char*>(write()))
     {
         return false;
     }
     
     std::string(p1, p2).swap(s);
-    read(p2 + sizeof(delim) - p1);
+    read(p2 + delim.length() - p1);
     return true;
 }
 
-bool Buffer::readString(std::string& s, const std::string& delim)
+// Read into a bytes array
+bool Buffer::readBlob(unsigned char* b, size_t n)
 {
-    if(readable() < delim.size())
+    if(readable() < n)
     {
         return false;
     }
     
-    const char* p1 = reinterpret_cast<const char*>(read());
-    const char* p2 = std::find_first_of(p1, reinterpret_cast<const char*>(write()), delim.begin(), delim.end());
-    if(p2 == reinterpret_cast<const char*>(write()))
+    memcpy(b, read(), n);
+    read(n);
+    return true;
+}
+
+// Read in network byte order
+uint16_t Buffer::readBE16()
+{
+    uint16_t v = peekBE16();
+    read(sizeof(v));
+    return v;
+}
+
+uint32_t Buffer::readBE32()
+{
+    uint32_t v = peekBE32();
+    read(sizeof(v));
+    return v;
+}
+
+uint64_t Buffer::readBE64()
+{
+    uint64_t v = peekBE64();
+    read(sizeof(v));
+    return v;
+}
+
+bool Buffer::readBE16Array(uint16_t* v, size_t n)
+{
+    size_t len = n * sizeof(uint16_t);
+    if(readable() < len)
     {
         return false;
     }
     
-    std::string(p1, p2).swap(s);
-    read(p2 + delim.size() - p1);
+    loadBE16Array(v, read(), n);
+    read(len);
     return true;
 }
 
-// Read into a bytes array
-bool Buffer::readBlob(unsigned char* b, size_t n)
+bool Buffer::readBE32Array(uint32_t* v, size_t n)
 {
-    if(readable() < n)
+    size_t len = n * sizeof(uint32_t);
+    if(readable() < len)
     {
         return false;
     }
     
-    memcpy(b, read(), n);
-    read(n);
+    loadBE32Array(v, read(), n);
+    read(len);
     return true;
 }
 
@@ -639,31 +875,23 @@ bool Buffer::peekString(std::string& s, size_t n, size_t offset) const
 
 bool Buffer::peekString(std::string& s, const char delim, size_t offset) const
 {
-    if(readable() < sizeof(delim) + offset)
-    {
-        return false;
-    }
-    
-    const char* p1 = reinterpret_cast<const char*>(peek(offset));
-    const char* p2 = std::find(p1, reinterpret_cast<const char*>(write()), delim);
-    if(p2 == reinterpret_cast<const char*>(write()))
-    {
-        return false;
-    }
-    
-    std::string(p1, p2).swap(s);
-    return true;
+    return peekString(s, DelimiterSet(delim), offset);
 }
 
 bool Buffer::peekString(std::string& s, const std::string& delim, size_t offset) const
 {
-    if(readable() < delim.size())
+    return peekString(s, DelimiterSet(delim), offset);
+}
+
+bool Buffer::peekString(std::string& s, const DelimiterSet& delim, size_t offset) const
+{
+    if(readable() < delim.length() + offset)
     {
         return false;
     }
     
     const char* p1 = reinterpret_cast<const char*>(peek(offset));
-    const char* p2 = std::find_first_of(p1, reinterpret_cast<const char*>(write()), delim.begin(), delim.end());
+    const char* p2 = delim.find(p1, reinterpret_cast<const char*>(write()));
     if(p2 == reinterpret_cast<const char*>(write()))
     {
         return false;
@@ -673,4 +901,42 @@ bool Buffer::peekString(std::string& s, const std::string& delim, size_t offset)
     return true;
 }
 
+// Peek in network byte order
+uint16_t Buffer::peekBE16(size_t offset) const
+{
+    assert(readable() >= sizeof(uint16_t) + offset);
+    return loadBE16(peek(offset));
+}
+
+uint32_t Buffer::peekBE32(size_t offset) const
+{
+    assert(readable() >= sizeof(uint32_t) + offset);
+    return loadBE32(peek(offset));
+}
+
+uint64_t Buffer::peekBE64(size_t offset) const
+{
+    assert(readable() >= sizeof(uint64_t) + offset);
+    return loadBE64(peek(offset));
+}
+
+// Update in network byte order
+void Buffer::updateBE16(uint16_t v, size_t offset)
+{
+    assert(readable() >= sizeof(v) + offset);
+    storeBE16(begin() + _read_index + offset, v);
+}
+
+void Buffer::updateBE32(uint32_t v, size_t offset)
+{
+    assert(readable() >= sizeof(v) + offset);
+    storeBE32(begin() + _read_index + offset, v);
+}
+
+void Buffer::updateBE64(uint64_t v, size_t offset)
+{
+    assert(readable() >= sizeof(v) + offset);
+    storeBE64(begin() + _read_index + offset, v);
+}
+
 NETWORK_END
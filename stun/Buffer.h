@@ -10,22 +10,27 @@
 #define NETWORK_BUFFER_H
 
 #include "Network.h"
+#include "ByteOrder.h"
 #include <string>
 #include <vector>
 #include <cassert>
 
 NETWORK_BEGIN
 
+class DelimiterSet;
+
 //
 // Buffer of bytes
-// Based on std::vector of unsigned char
+// Based on a block of heap memory that grows on demand
 //
 
 class Buffer
 {
 public:
-    Buffer(size_t limit = 0); // limit the max size of buffer ?Include bytes before _read_index?
+    Buffer(size_t limit = 0); // limit the max size of buffer, include bytes before _read_index
     Buffer(const unsigned char* b, size_t n); // Wrapper of a memory block
+    Buffer(const Buffer& other); // Copy readable bytes
+    Buffer& operator=(const Buffer& other); // Copy readable bytes, as many as fit
     ~Buffer();
     
     // empty the buffer
@@ -36,28 +41,21 @@ public:
     }
     
     // Swap two buffers without copy
-    void swap(Buffer& b)
-    {
-        _v.swap(b._v);
-        std::swap(_read_index, b._read_index);
-        std::swap(_write_index, b._write_index);
-        std::swap(_max_size, b._max_size);
-    }
+    // Readable bytes are copied if a buffer doesn't own its memory
+    // (InlineBuffer, RingBuffer), and bytes that don't fit are dropped
+    void swap(Buffer& b);
     
     // Swap two buffers without copy
     void swap(Buffer* b)
     {
-        _v.swap(b->_v);
-        std::swap(_read_index, b->_read_index);
-        std::swap(_write_index, b->_write_index);
-        std::swap(_max_size, b->_max_size);
+        swap(*b);
     }
     
     // bytes number of the buffer
     // size() = readable() + writable()
     size_t size() const
     {
-        return _v.size() - _read_index;
+        return readable() + writable();
     }
     
     // available bytes to read
@@ -69,7 +67,7 @@ public:
     // free bytes to write
     size_t writable() const
     {
-        return _v.size() - _write_index;
+        return _ring ? _capacity - readable() : _capacity - _write_index;
     }
     
     //
@@ -98,10 +96,14 @@ public:
     
     void write(size_t n)
     {
-        assert(_write_index + n <= _v.size());
+        assert(n <= writable());
         _write_index += n;
     }
     
+    // Make sure n bytes are writable
+    // Unread bytes are moved to front if that makes enough room,
+    // otherwise the memory grows geometrically, up to the max size
+    // A ring never grows, returns what is writable
     size_t reserve(size_t n)
     {
         if(n == 0 || writable() >= n)
@@ -109,16 +111,7 @@ public:
             return writable();
         }
         
-        if(_max_size > 0 && (_v.size() + n) > _max_size)
-        {
-            _v.resize(_max_size);
-        }
-        else
-        {
-            _v.resize(_v.size() + n);
-        }
-        
-        return writable();
+        return expand(n);
     }
     
     // Write particular data type
@@ -143,6 +136,14 @@ public:
     size_t writeString(const std::string& s, const std::string& delim);
     
     size_t writeBlob(const unsigned char* b, size_t n);
+    
+    // Write in network byte order (big endian)
+    size_t writeBE16(uint16_t v);
+    size_t writeBE32(uint32_t v);
+    size_t writeBE64(uint64_t v);
+    
+    size_t writeBE16Array(const uint16_t* v, size_t n);
+    size_t writeBE32Array(const uint32_t* v, size_t n);
 
     //
     // Read data in buffer
@@ -169,6 +170,12 @@ public:
         if(readable() > n)
         {
             _read_index += n;
+            if(_ring && _read_index >= _capacity)
+            {
+                // Same bytes are mapped at index - capacity
+                _read_index -= _capacity;
+                _write_index -= _capacity;
+            }
         }
         else
         {
@@ -202,9 +209,18 @@ public:
     bool readString(std::string& s, size_t n);
     bool readString(std::string& s, const char delim);
     bool readString(std::string& s, const std::string& delim);
+    bool readString(std::string& s, const DelimiterSet& delim); // Prebuilt set, for repeated reads
     
     bool readBlob(unsigned char* b, size_t n);
     
+    // Read in network byte order (big endian)
+    uint16_t readBE16();
+    uint32_t readBE32();
+    uint64_t readBE64();
+    
+    bool readBE16Array(uint16_t* v, size_t n);
+    bool readBE32Array(uint32_t* v, size_t n);
+    
     //
     // Peek data in buffer
     // Data is not removed from the buffer
@@ -236,6 +252,12 @@ public:
     bool peekString(std::string& s, size_t n, size_t offset = 0) const;
     bool peekString(std::string& s, const char delim, size_t offset = 0) const;
     bool peekString(std::string& s, const std::string& delim, size_t offset = 0) const;
+    bool peekString(std::string& s, const DelimiterSet& delim, size_t offset = 0) const;
+    
+    // Peek in network byte order (big endian)
+    uint16_t peekBE16(size_t offset = 0) const;
+    uint32_t peekBE32(size_t offset = 0) const;
+    uint64_t peekBE64(size_t offset = 0) const;
     
     //
     // Update data in buffer
@@ -260,6 +282,11 @@ public:
     void updateFloat(float v, size_t offset = 0);
     void updateDouble(double v, size_t offset = 0);
     
+    // Update in network byte order (big endian)
+    void updateBE16(uint16_t v, size_t offset = 0);
+    void updateBE32(uint32_t v, size_t offset = 0);
+    void updateBE64(uint64_t v, size_t offset = 0);
+    
     // Receive data from socket and write into buffer
     ssize_t receive(SOCKET fd);
     ssize_t receiveFrom(SOCKET fd, struct sockaddr_storage* from);
@@ -268,38 +295,108 @@ public:
     ssize_t send(SOCKET fd);
     ssize_t sendTo(SOCKET fd, struct sockaddr_storage* to);
     
+protected:
+    
+    // Start with memory owned by derived class, not heap
+    // Grow into heap memory when more than n bytes are needed
+    Buffer(unsigned char* data, size_t n, size_t limit);
+    
+    // Use memory owned by derived class instead of heap, drop all data
+    // A ring memory of n bytes is mapped twice back to back, so n bytes
+    // from any index below n are contiguous
+    void attach(unsigned char* data, size_t n, bool ring);
+    
 private:
     
     //
-    //        |                        -size()-                          |
-    // vector |##########################################################|-------------|
-    //      begin()                                                     end()       capacity
+    //        |                       -capacity-                         |
+    // memory |##########################################################|
+    //      begin()                                                     end()
     //
     //
     //
     //                 |               -size()-                          |
-    // Buffer |--------|#########################|***********************|-------------|
+    // Buffer |--------|#########################|***********************|
     //                        -readable()-              -writable()-
-    //      begin() read_index               write_index                end()       capacity
+    //      begin() read_index               write_index                end()
     //
     //
+    //
+    //                 |               -size()-                          |
+    // Ring   |********|#########################|***********************|###|
+    //                        -readable()-              -writable()-
+    //      begin() read_index               write_index              end()  read_index
+    //                                                                  + capacity
+    //
     
     unsigned char* begin()
     {
-        return &_v[0];
+        return _data;
     }
     
     const unsigned char* begin() const
     {
-        return &_v[0];
+        return _data;
     }
+    
+    size_t expand(size_t n); // Make room for n bytes, slow path of reserve()
 
-    std::vector<unsigned char> _v;
+    unsigned char* _data; // Memory block, not initialized
+    size_t _capacity; // Size of memory block
+    bool _owned; // Memory block is allocated and freed by buffer, or by derived class
+    bool _ring; // Memory block is mapped twice, see attach()
     size_t _max_size; // Limitation of the size of the container
     size_t _read_index; // Index of first readable
     size_t _write_index; // Index of first writable
 };
 
+//
+// Buffer with inline memory of N bytes
+// Lives on the stack or inside another object, the heap is only used
+// when the buffer grows beyond N bytes
+//
+// network::InlineBuffer<MESSAGE_BUFFER_SIZE> buf;
+// msg->toBuffer(&buf);
+//
+
+template<size_t N>
+class InlineBuffer : public Buffer
+{
+public:
+    InlineBuffer(size_t limit = 0)
+    : Buffer(_storage, N, limit)
+    {
+
+    }
+    
+    InlineBuffer(const Buffer& other)
+    : Buffer(_storage, N, 0)
+    {
+        Buffer::operator=(other);
+    }
+    
+    InlineBuffer(const InlineBuffer& other)
+    : Buffer(_storage, N, 0)
+    {
+        Buffer::operator=(other);
+    }
+    
+    InlineBuffer& operator=(const Buffer& other)
+    {
+        Buffer::operator=(other);
+        return *this;
+    }
+    
+    InlineBuffer& operator=(const InlineBuffer& other)
+    {
+        Buffer::operator=(other);
+        return *this;
+    }
+    
+private:
+    unsigned char _storage[N];
+};
+
 NETWORK_END
 
 #endif 
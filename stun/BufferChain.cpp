@@ -0,0 +1,262 @@
+//
+//  BufferChain.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "BufferChain.h"
+#include <algorithm>
+
+#if !defined(_WIN32)
+#   include <sys/uio.h>
+#endif
+
+NETWORK_BEGIN
+
+#if defined(_WIN32)
+typedef WSABUF IOVEC;
+#else
+typedef struct iovec IOVEC;
+#endif
+
+static socklen_t addressLength(const struct sockaddr_storage* ss)
+{
+    if(ss->ss_family == PF_INET)
+    {
+        return sizeof(sockaddr_in);
+    }
+    else if(ss->ss_family == PF_INET6)
+    {
+        return sizeof(sockaddr_in6);
+    }
+    
+    assert(false);
+    return static_cast<socklen_t>(sizeof(sockaddr_storage));
+}
+
+// Fill I/O vectors with segments
+template<typename Segments>
+static size_t fill(IOVEC* iov, const Segments& segments)
+{
+    size_t n = std::min(segments.size(), (size_t)MAX_CHAIN_SEGMENTS);
+    for(size_t i = 0; i < n; ++i)
+    {
+#if defined(_WIN32)
+        iov[i].buf = reinterpret_cast<char*>(segments[i].data);
+        iov[i].len = static_cast<ULONG>(segments[i].size);
+#else
+        iov[i].iov_base = segments[i].data;
+        iov[i].iov_len = segments[i].size;
+#endif
+    }
+    return n;
+}
+
+// Send vectors as one message, to address if not NULL
+static ssize_t sendVectors(SOCKET fd, IOVEC* iov, size_t n, struct sockaddr_storage* to)
+{
+#if defined(_WIN32)
+    DWORD count = 0;
+    int rc = ::WSASendTo(fd, iov, static_cast<DWORD>(n), &count, 0,
+                         reinterpret_cast<struct sockaddr*>(to), to != NULL ? addressLength(to) : 0, NULL, NULL);
+    return rc == 0 ? static_cast<ssize_t>(count) : -1;
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = to;
+    msg.msg_namelen = to != NULL ? addressLength(to) : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    return ::sendmsg(fd, &msg, 0);
+#endif
+}
+
+// Receive a message into vectors, from address is returned if not NULL
+static ssize_t receiveVectors(SOCKET fd, IOVEC* iov, size_t n, struct sockaddr_storage* from)
+{
+    socklen_t fromlen = static_cast<socklen_t>(sizeof(sockaddr_storage));
+    if(from != NULL)
+    {
+        memset(from, 0, sizeof(struct sockaddr_storage));
+    }
+#if defined(_WIN32)
+    DWORD count = 0;
+    DWORD flags = 0;
+    int rc = ::WSARecvFrom(fd, iov, static_cast<DWORD>(n), &count, &flags,
+                           reinterpret_cast<struct sockaddr*>(from), from != NULL ? &fromlen : NULL, NULL, NULL);
+    return rc == 0 ? static_cast<ssize_t>(count) : -1;
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = from;
+    msg.msg_namelen = from != NULL ? fromlen : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    return ::recvmsg(fd, &msg, 0);
+#endif
+}
+
+BufferChain::BufferChain()
+{
+    
+}
+
+BufferChain::~BufferChain()
+{
+    
+}
+
+size_t BufferChain::size() const
+{
+    size_t n = 0;
+    for(size_t i = 0; i < _segments.size(); ++i)
+    {
+        n += _segments[i].size;
+    }
+    return n;
+}
+
+void BufferChain::append(const unsigned char* b, size_t n)
+{
+    assert(_segments.size() < MAX_CHAIN_SEGMENTS);
+    Segment s = { const_cast<unsigned char*>(b), n, NULL };
+    _segments.push_back(s);
+}
+
+void BufferChain::append(Buffer* buf)
+{
+    assert(buf != NULL);
+    assert(_segments.size() < MAX_CHAIN_SEGMENTS);
+    Segment s = { const_cast<unsigned char*>(buf->read()), buf->readable(), buf };
+    _segments.push_back(s);
+}
+
+void BufferChain::reserve(unsigned char* b, size_t n)
+{
+    assert(_segments.size() < MAX_CHAIN_SEGMENTS);
+    Segment s = { b, n, NULL };
+    _segments.push_back(s);
+}
+
+// Only one segment for a buffer, as they would share the writable bytes
+void BufferChain::reserve(Buffer* buf, size_t n)
+{
+    assert(buf != NULL);
+    assert(_segments.size() < MAX_CHAIN_SEGMENTS);
+    buf->reserve(n);
+    Segment s = { buf->write(), std::min(n, buf->writable()), buf };
+    _segments.push_back(s);
+}
+
+// Output data to socket
+ssize_t BufferChain::send(SOCKET fd)
+{
+    assert(fd != INVALID_SOCKET);
+    
+    ssize_t count = 0;
+    while(!_segments.empty())
+    {
+        IOVEC iov[MAX_CHAIN_SEGMENTS];
+        size_t n = fill(iov, _segments);
+        ssize_t rc = sendVectors(fd, iov, n, NULL);
+        if(rc <= 0)
+        {
+            break;
+        }
+        
+        sent(rc);
+        count += rc;
+    }
+    
+    return count;
+}
+
+// Datagram socket, all segments in one datagram
+ssize_t BufferChain::sendTo(SOCKET fd, struct sockaddr_storage* to)
+{
+    assert(fd != INVALID_SOCKET);
+    assert(to != NULL);
+    
+    IOVEC iov[MAX_CHAIN_SEGMENTS];
+    size_t n = fill(iov, _segments);
+    ssize_t rc = sendVectors(fd, iov, n, to);
+    if(rc > 0)
+    {
+        sent(rc);
+    }
+    
+    return rc;
+}
+
+// Input data from socket
+ssize_t BufferChain::receive(SOCKET fd)
+{
+    assert(fd != INVALID_SOCKET);
+    
+    IOVEC iov[MAX_CHAIN_SEGMENTS];
+    size_t n = fill(iov, _segments);
+    ssize_t rc = receiveVectors(fd, iov, n, NULL);
+    if(rc > 0)
+    {
+        received(rc);
+    }
+    
+    return rc;
+}
+
+// Receive from datagram socket
+ssize_t BufferChain::receiveFrom(SOCKET fd, struct sockaddr_storage* from)
+{
+    assert(fd != INVALID_SOCKET);
+    assert(from != NULL);
+    
+    IOVEC iov[MAX_CHAIN_SEGMENTS];
+    size_t n = fill(iov, _segments);
+    ssize_t rc = receiveVectors(fd, iov, n, from);
+    if(rc > 0)
+    {
+        received(rc);
+    }
+    
+    return rc;
+}
+
+void BufferChain::sent(size_t n)
+{
+    size_t i = 0;
+    while(i < _segments.size())
+    {
+        Segment& s = _segments[i];
+        size_t k = std::min(n, s.size);
+        if(s.buffer != NULL && k > 0)
+        {
+            s.buffer->read(k);
+        }
+        s.data += k;
+        s.size -= k;
+        n -= k;
+        if(s.size > 0)
+        {
+            break;
+        }
+        ++i;
+    }
+    _segments.erase(_segments.begin(), _segments.begin() + i);
+}
+
+void BufferChain::received(size_t n)
+{
+    for(size_t i = 0; i < _segments.size() && n > 0; ++i)
+    {
+        Segment& s = _segments[i];
+        size_t k = std::min(n, s.size);
+        if(s.buffer != NULL)
+        {
+            s.buffer->write(k);
+        }
+        n -= k;
+    }
+}
+
+NETWORK_END
@@ -0,0 +1,101 @@
+//
+//  BufferChain.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_BUFFER_CHAIN_H
+#define NETWORK_BUFFER_CHAIN_H
+
+#include "Buffer.h"
+#include <vector>
+
+NETWORK_BEGIN
+
+//
+// Chain of memory segments
+// Segments are sent or received with one system call (writev, sendmsg,
+// readv, recvmsg), so a message made of pieces need not be concatenated
+// Memory of segments is not copied, it must outlive the chain
+//
+// network::BufferChain chain;
+// chain.append(header);    // Buffer, sent bytes are removed
+// chain.append(block, n);  // Cached bytes, left as is
+// chain.sendTo(fd, &to);
+//
+
+#define MAX_CHAIN_SEGMENTS 64
+
+class BufferChain
+{
+public:
+    BufferChain();
+    ~BufferChain();
+
+    // Remove all segments
+    void clear()
+    {
+        _segments.clear();
+    }
+
+    // Number of segments
+    size_t count() const
+    {
+        return _segments.size();
+    }
+
+    // Total bytes of all segments
+    size_t size() const;
+
+    //
+    // Segments to send
+    //
+
+    // Memory block
+    void append(const unsigned char* b, size_t n);
+
+    // Readable bytes of buffer, removed from buffer once sent
+    void append(Buffer* buf);
+
+    //
+    // Segments to receive into
+    //
+
+    // Memory block
+    // Received bytes fill the segments in order
+    void reserve(unsigned char* b, size_t n);
+
+    // Writable bytes of buffer, n bytes are reserved first
+    // Received bytes are appended to buffer
+    void reserve(Buffer* buf, size_t n);
+
+    // Send segments to socket, in order
+    // Stream socket sends until all bytes are sent or an error
+    ssize_t send(SOCKET fd);
+    ssize_t sendTo(SOCKET fd, struct sockaddr_storage* to);
+
+    // Receive into segments, in order
+    ssize_t receive(SOCKET fd);
+    ssize_t receiveFrom(SOCKET fd, struct sockaddr_storage* from);
+
+private:
+    struct Segment
+    {
+        unsigned char* data;
+        size_t size;
+        Buffer* buffer; // Owner of memory, or NULL
+    };
+
+    std::vector<Segment> _segments;
+
+    // Remove n bytes sent from front segments
+    void sent(size_t n);
+
+    // Commit n bytes received into segments
+    void received(size_t n);
+};
+
+NETWORK_END
+
+#endif
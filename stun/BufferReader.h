@@ -0,0 +1,210 @@
+//
+//  BufferReader.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_BUFFER_READER_H
+#define NETWORK_BUFFER_READER_H
+
+#include "BufferView.h"
+#include "ByteOrder.h"
+#include <cassert>
+
+NETWORK_BEGIN
+
+//
+// Cursor to parse structures from untrusted memory
+// Check the length of a structure once with require(), then get its
+// fields with no more checks
+// A failed check sets a sticky flag and empties the reader, so checked
+// reads after it return 0, and one good() at the end tells if all went well
+//
+// network::BufferReader r(buf->read(), buf->readable());
+// if(r.require(8))
+// {
+//     r.get8u();
+//     family = r.get8u();
+//     port = r.getBE16();
+//     addr = r.getBE32();
+// }
+// return r.good();
+//
+
+class BufferReader
+{
+public:
+    BufferReader(const unsigned char* b, size_t n)
+    : _begin(b)
+    , _read(b)
+    , _end(b + n)
+    , _failed(false)
+    {
+
+    }
+
+    explicit BufferReader(const BufferView& view)
+    : _begin(view.read())
+    , _read(view.read())
+    , _end(view.read() + view.readable())
+    , _failed(false)
+    {
+
+    }
+
+    // No check failed so far
+    bool good() const
+    {
+        return !_failed;
+    }
+
+    bool failed() const
+    {
+        return _failed;
+    }
+
+    // Mark as failed, no more bytes to read
+    void fail()
+    {
+        _failed = true;
+        _read = _end;
+    }
+
+    // available bytes to read
+    size_t readable() const
+    {
+        return _end - _read;
+    }
+
+    // bytes read since begin
+    size_t consumed() const
+    {
+        return _read - _begin;
+    }
+
+    const unsigned char* read() const
+    {
+        return _read;
+    }
+
+    // Make sure n bytes are readable, fail if not
+    bool require(size_t n)
+    {
+        if(readable() < n)
+        {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    //
+    // Get fields with no check
+    // Only after require() of enough bytes
+    //
+
+    uint8_t get8u()
+    {
+        assert(readable() >= 1);
+        return *_read++;
+    }
+
+    uint16_t getBE16()
+    {
+        assert(readable() >= 2);
+        uint16_t v = loadBE16(_read);
+        _read += 2;
+        return v;
+    }
+
+    uint32_t getBE32()
+    {
+        assert(readable() >= 4);
+        uint32_t v = loadBE32(_read);
+        _read += 4;
+        return v;
+    }
+
+    uint64_t getBE64()
+    {
+        assert(readable() >= 8);
+        uint64_t v = loadBE64(_read);
+        _read += 8;
+        return v;
+    }
+
+    // Pointer to n bytes, skipped
+    const unsigned char* get(size_t n)
+    {
+        assert(readable() >= n);
+        const unsigned char* p = _read;
+        _read += n;
+        return p;
+    }
+
+    //
+    // Read fields with check
+    // Return 0 if failed
+    //
+
+    uint8_t read8u()
+    {
+        return require(1) ? get8u() : 0;
+    }
+
+    uint16_t readBE16()
+    {
+        return require(2) ? getBE16() : 0;
+    }
+
+    uint32_t readBE32()
+    {
+        return require(4) ? getBE32() : 0;
+    }
+
+    uint64_t readBE64()
+    {
+        return require(8) ? getBE64() : 0;
+    }
+
+    bool readBlob(unsigned char* b, size_t n)
+    {
+        if(!require(n))
+        {
+            return false;
+        }
+        memcpy(b, get(n), n);
+        return true;
+    }
+
+    bool skip(size_t n)
+    {
+        if(!require(n))
+        {
+            return false;
+        }
+        _read += n;
+        return true;
+    }
+
+    // View of next n bytes, skipped
+    BufferView view(size_t n)
+    {
+        if(!require(n))
+        {
+            return BufferView();
+        }
+        return BufferView(get(n), n);
+    }
+
+private:
+    const unsigned char* _begin;
+    const unsigned char* _read;
+    const unsigned char* _end;
+    bool _failed;
+};
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,359 @@
+//
+//  BufferView.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "BufferView.h"
+#include "Delimiter.h"
+
+NETWORK_BEGIN
+
+BufferView::BufferView()
+: _read(NULL)
+, _end(NULL)
+{
+
+}
+
+BufferView::BufferView(const unsigned char* b, size_t n)
+: _read(b)
+, _end(b + n)
+{
+
+}
+
+BufferView::BufferView(const Buffer& buf)
+: _read(buf.read())
+, _end(buf.read() + buf.readable())
+{
+
+}
+
+BufferView::~BufferView()
+{
+
+}
+
+// Read particular data type
+int8_t BufferView::read8()
+{
+    int8_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+uint8_t BufferView::read8u()
+{
+    uint8_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+int16_t BufferView::read16()
+{
+    int16_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+uint16_t BufferView::read16u()
+{
+    uint16_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+int32_t BufferView::read32()
+{
+    int32_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+uint32_t BufferView::read32u()
+{
+    uint32_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+int64_t BufferView::read64()
+{
+    int64_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+uint64_t BufferView::read64u()
+{
+    uint64_t v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+bool BufferView::readBool()
+{
+    return read8() != 0;
+}
+
+float BufferView::readFloat()
+{
+    float v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+double BufferView::readDouble()
+{
+    double v = 0;
+    load(&v, sizeof(v), 0);
+    read(sizeof(v));
+    return v;
+}
+
+bool BufferView::readString(StringView& s, size_t n)
+{
+    if(!peekString(s, n))
+    {
+        return false;
+    }
+
+    read(n);
+    return true;
+}
+
+bool BufferView::readString(StringView& s, const char delim)
+{
+    if(!peekString(s, delim))
+    {
+        return false;
+    }
+
+    read(s.size() + sizeof(delim));
+    return true;
+}
+
+bool BufferView::readString(StringView& s, const std::string& delim)
+{
+    if(!peekString(s, delim))
+    {
+        return false;
+    }
+
+    read(s.size() + delim.size());
+    return true;
+}
+
+bool BufferView::readString(StringView& s, const DelimiterSet& delim)
+{
+    if(!peekString(s, delim))
+    {
+        return false;
+    }
+
+    read(s.size() + delim.length());
+    return true;
+}
+
+// Read into a bytes array
+bool BufferView::readBlob(unsigned char* b, size_t n)
+{
+    if(readable() < n)
+    {
+        return false;
+    }
+
+    memcpy(b, read(), n);
+    read(n);
+    return true;
+}
+
+// Read in network byte order
+uint16_t BufferView::readBE16()
+{
+    uint16_t v = peekBE16();
+    read(sizeof(v));
+    return v;
+}
+
+uint32_t BufferView::readBE32()
+{
+    uint32_t v = peekBE32();
+    read(sizeof(v));
+    return v;
+}
+
+uint64_t BufferView::readBE64()
+{
+    uint64_t v = peekBE64();
+    read(sizeof(v));
+    return v;
+}
+
+bool BufferView::readBE16Array(uint16_t* v, size_t n)
+{
+    size_t len = n * sizeof(uint16_t);
+    if(readable() < len)
+    {
+        return false;
+    }
+
+    loadBE16Array(v, read(), n);
+    read(len);
+    return true;
+}
+
+bool BufferView::readBE32Array(uint32_t* v, size_t n)
+{
+    size_t len = n * sizeof(uint32_t);
+    if(readable() < len)
+    {
+        return false;
+    }
+
+    loadBE32Array(v, read(), n);
+    read(len);
+    return true;
+}
+
+// Peek particular data type
+int8_t BufferView::peek8(size_t offset) const
+{
+    int8_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+uint8_t BufferView::peek8u(size_t offset) const
+{
+    uint8_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+int16_t BufferView::peek16(size_t offset) const
+{
+    int16_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+uint16_t BufferView::peek16u(size_t offset) const
+{
+    uint16_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+int32_t BufferView::peek32(size_t offset) const
+{
+    int32_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+uint32_t BufferView::peek32u(size_t offset) const
+{
+    uint32_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+int64_t BufferView::peek64(size_t offset) const
+{
+    int64_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+uint64_t BufferView::peek64u(size_t offset) const
+{
+    uint64_t v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+bool BufferView::peekBool(size_t offset) const
+{
+    return peek8(offset) != 0;
+}
+
+float BufferView::peekFloat(size_t offset) const
+{
+    float v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+double BufferView::peekDouble(size_t offset) const
+{
+    double v = 0;
+    load(&v, sizeof(v), offset);
+    return v;
+}
+
+bool BufferView::peekString(StringView& s, size_t n, size_t offset) const
+{
+    if(readable() < n + offset)
+    {
+        return false;
+    }
+
+    s = StringView(reinterpret_cast<const char*>(_read + offset), n);
+    return true;
+}
+
+bool BufferView::peekString(StringView& s, const char delim, size_t offset) const
+{
+    if(readable() < sizeof(delim) + offset)
+    {
+        return false;
+    }
+
+    const char* p1 = reinterpret_cast<const char*>(_read + offset);
+    const char* p2 = static_cast<const char*>(memchr(p1, delim, readable() - offset));
+    if(p2 == NULL)
+    {
+        return false;
+    }
+
+    s = StringView(p1, p2 - p1);
+    return true;
+}
+
+bool BufferView::peekString(StringView& s, const std::string& delim, size_t offset) const
+{
+    return peekString(s, DelimiterSet(delim), offset);
+}
+
+bool BufferView::peekString(StringView& s, const DelimiterSet& delim, size_t offset) const
+{
+    if(readable() < delim.length() + offset)
+    {
+        return false;
+    }
+
+    const char* p1 = reinterpret_cast<const char*>(_read + offset);
+    const char* end = reinterpret_cast<const char*>(_end);
+    const char* p2 = delim.find(p1, end);
+    if(p2 == end)
+    {
+        return false;
+    }
+
+    s = StringView(p1, p2 - p1);
+    return true;
+}
+
+NETWORK_END
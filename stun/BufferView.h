@@ -0,0 +1,240 @@
+//
+//  BufferView.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_BUFFER_VIEW_H
+#define NETWORK_BUFFER_VIEW_H
+
+#include "Buffer.h"
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+NETWORK_BEGIN
+
+//
+// Read-only reference to a range of chars
+// Only valid while the referenced memory is alive
+//
+
+class StringView
+{
+public:
+    StringView()
+    : _data(NULL)
+    , _size(0)
+    {
+
+    }
+
+    StringView(const char* p, size_t n)
+    : _data(p)
+    , _size(n)
+    {
+
+    }
+
+    StringView(const std::string& s)
+    : _data(s.data())
+    , _size(s.size())
+    {
+
+    }
+
+    const char* data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    std::string toString() const
+    {
+        return std::string(_data, _size);
+    }
+
+    bool operator==(const StringView& other) const
+    {
+        return _size == other._size && (_size == 0 || memcmp(_data, other._data, _size) == 0);
+    }
+
+    bool operator!=(const StringView& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    const char* _data;
+    size_t _size;
+};
+
+//
+// Read-only view of bytes
+// Wraps memory owned by others (a received datagram, a mapped file),
+// no copy is made, so the memory must outlive the view
+//
+
+class BufferView
+{
+public:
+    BufferView();
+    BufferView(const unsigned char* b, size_t n);
+    explicit BufferView(const Buffer& buf); // View of readable bytes of buffer
+    ~BufferView();
+
+    // available bytes to read
+    size_t readable() const
+    {
+        return _end - _read;
+    }
+
+    //
+    // Read data in view
+    // Always read from the first readable byte
+    // The data is skipped after read
+    //
+
+    const unsigned char* read() const
+    {
+        return _read;
+    }
+
+    void read(size_t n)
+    {
+        _read = readable() > n ? _read + n : _end;
+    }
+
+    void remove(size_t n)
+    {
+        read(n);
+    }
+
+    // View of n bytes from offset, limited to the readable bytes
+    BufferView slice(size_t offset, size_t n) const
+    {
+        if(offset > readable())
+        {
+            return BufferView();
+        }
+        return BufferView(_read + offset, std::min(n, readable() - offset));
+    }
+
+    // Read with particular data type
+    int8_t read8();
+    uint8_t read8u();
+
+    int16_t read16();
+    uint16_t read16u();
+
+    int32_t read32();
+    uint32_t read32u();
+
+    int64_t read64();
+    uint64_t read64u();
+
+    bool readBool();
+    float readFloat();
+    double readDouble();
+
+    // Strings refer to the viewed memory
+    bool readString(StringView& s, size_t n);
+    bool readString(StringView& s, const char delim);
+    bool readString(StringView& s, const std::string& delim);
+    bool readString(StringView& s, const DelimiterSet& delim); // Prebuilt set, for repeated reads
+
+    bool readBlob(unsigned char* b, size_t n);
+
+    // Read in network byte order (big endian)
+    uint16_t readBE16();
+    uint32_t readBE32();
+    uint64_t readBE64();
+
+    bool readBE16Array(uint16_t* v, size_t n);
+    bool readBE32Array(uint32_t* v, size_t n);
+
+    //
+    // Peek data in view
+    // Data is not skipped
+    // Can peek data at a random position
+    //
+
+    const unsigned char* peek(size_t offset = 0) const
+    {
+        return readable() > offset ? _read + offset : NULL;
+    }
+
+    // Peek particular data type
+    int8_t peek8(size_t offset = 0) const;
+    uint8_t peek8u(size_t offset = 0) const;
+
+    int16_t peek16(size_t offset = 0) const;
+    uint16_t peek16u(size_t offset = 0) const;
+
+    int32_t peek32(size_t offset = 0) const;
+    uint32_t peek32u(size_t offset = 0) const;
+
+    int64_t peek64(size_t offset = 0) const;
+    uint64_t peek64u(size_t offset = 0) const;
+
+    bool peekBool(size_t offset = 0) const;
+    float peekFloat(size_t offset = 0) const;
+    double peekDouble(size_t offset = 0) const;
+
+    bool peekString(StringView& s, size_t n, size_t offset = 0) const;
+    bool peekString(StringView& s, const char delim, size_t offset = 0) const;
+    bool peekString(StringView& s, const std::string& delim, size_t offset = 0) const;
+    bool peekString(StringView& s, const DelimiterSet& delim, size_t offset = 0) const;
+
+    // Peek in network byte order (big endian)
+    uint16_t peekBE16(size_t offset = 0) const
+    {
+        assert(readable() >= sizeof(uint16_t) + offset);
+        return loadBE16(_read + offset);
+    }
+
+    uint32_t peekBE32(size_t offset = 0) const
+    {
+        assert(readable() >= sizeof(uint32_t) + offset);
+        return loadBE32(_read + offset);
+    }
+
+    uint64_t peekBE64(size_t offset = 0) const
+    {
+        assert(readable() >= sizeof(uint64_t) + offset);
+        return loadBE64(_read + offset);
+    }
+
+private:
+
+    //
+    //                 |         -readable()-       |
+    // View   |--------|############################|
+    //      begin     read                         end
+    //
+
+    const unsigned char* _read; // First readable
+    const unsigned char* _end; // One past last readable
+
+    // Copy n bytes from offset without alignment requirement
+    void load(void* v, size_t n, size_t offset) const
+    {
+        assert(readable() >= n + offset);
+        memcpy(v, _read + offset, n);
+    }
+};
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,186 @@
+//
+//  BufferWriter.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_BUFFER_WRITER_H
+#define NETWORK_BUFFER_WRITER_H
+
+#include "Buffer.h"
+#include "ByteOrder.h"
+#include <cstring>
+#include <cassert>
+
+NETWORK_BEGIN
+
+//
+// Cursor to pack structures into raw memory
+// Mirror of BufferReader: check the room for a structure once with
+// require(), then put its fields with no more checks
+// A failed check sets a sticky overflow flag and fills the memory up,
+// so checked writes after it do nothing, and one good() at the end
+// tells if all fit
+//
+// unsigned char b[64];
+// network::BufferWriter w(b, sizeof(b));
+// if(w.require(8))
+// {
+//     w.put8u(0);
+//     w.put8u(family);
+//     w.putBE16(port);
+//     w.putBE32(addr);
+// }
+// return w.good() ? w.written() : 0;
+//
+
+class BufferWriter
+{
+public:
+    BufferWriter(unsigned char* b, size_t n)
+    : _begin(b)
+    , _write(b)
+    , _end(b + n)
+    , _overflowed(false)
+    {
+
+    }
+
+    // No check failed so far
+    bool good() const
+    {
+        return !_overflowed;
+    }
+
+    bool overflowed() const
+    {
+        return _overflowed;
+    }
+
+    // Mark as overflowed, no more room to write
+    void overflow()
+    {
+        _overflowed = true;
+        _write = _end;
+    }
+
+    // available bytes to write
+    size_t writable() const
+    {
+        return _end - _write;
+    }
+
+    // bytes written since begin
+    size_t written() const
+    {
+        return _write - _begin;
+    }
+
+    unsigned char* write() const
+    {
+        return _write;
+    }
+
+    // Make sure n bytes are writable, overflow if not
+    bool require(size_t n)
+    {
+        if(writable() < n)
+        {
+            overflow();
+            return false;
+        }
+        return true;
+    }
+
+    //
+    // Put fields with no check
+    // Only after require() of enough bytes
+    //
+
+    void put8u(uint8_t v)
+    {
+        assert(writable() >= 1);
+        *_write++ = v;
+    }
+
+    void putBE16(uint16_t v)
+    {
+        assert(writable() >= 2);
+        storeBE16(_write, v);
+        _write += 2;
+    }
+
+    void putBE32(uint32_t v)
+    {
+        assert(writable() >= 4);
+        storeBE32(_write, v);
+        _write += 4;
+    }
+
+    void putBE64(uint64_t v)
+    {
+        assert(writable() >= 8);
+        storeBE64(_write, v);
+        _write += 8;
+    }
+
+    void put(const unsigned char* b, size_t n)
+    {
+        assert(writable() >= n);
+        memcpy(_write, b, n);
+        _write += n;
+    }
+
+    //
+    // Write fields with check
+    // Return false if overflowed
+    //
+
+    bool write8u(uint8_t v)
+    {
+        return require(1) ? (put8u(v), true) : false;
+    }
+
+    bool writeBE16(uint16_t v)
+    {
+        return require(2) ? (putBE16(v), true) : false;
+    }
+
+    bool writeBE32(uint32_t v)
+    {
+        return require(4) ? (putBE32(v), true) : false;
+    }
+
+    bool writeBE64(uint64_t v)
+    {
+        return require(8) ? (putBE64(v), true) : false;
+    }
+
+    bool writeBlob(const unsigned char* b, size_t n)
+    {
+        return require(n) ? (put(b, n), true) : false;
+    }
+
+    // Write n bytes of c
+    bool fill(unsigned char c, size_t n)
+    {
+        if(!require(n))
+        {
+            return false;
+        }
+        memset(_write, c, n);
+        _write += n;
+        return true;
+    }
+
+private:
+    unsigned char* _begin;
+    unsigned char* _write;
+    unsigned char* _end;
+    bool _overflowed;
+};
+
+NETWORK_END
+
+#endif
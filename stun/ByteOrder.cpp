@@ -0,0 +1,171 @@
+//
+//  ByteOrder.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "ByteOrder.h"
+
+#if defined(__SSSE3__)
+#   include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#endif
+
+NETWORK_BEGIN
+
+//
+// Swap bytes of each 2 or 4 bytes in a block of n bytes
+// Source and destination may be the same, not other overlap
+// The tail of n % 16 bytes is left to the caller
+//
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+
+// Network order is host order, nothing to swap
+static size_t swapBlock16(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    memmove(dst, src, n);
+    return n;
+}
+
+static size_t swapBlock32(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    memmove(dst, src, n);
+    return n;
+}
+
+#elif defined(__SSSE3__)
+
+static size_t swapBlock16(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+static size_t swapBlock32(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+static inline __m128i swap16x8(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static size_t swapBlock16(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), swap16x8(v));
+    }
+    return i;
+}
+
+static size_t swapBlock32(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        // Swap 16 bit halves of each 32 bits, then bytes of each half
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), swap16x8(v));
+    }
+    return i;
+}
+
+#elif defined(__ARM_NEON)
+
+static size_t swapBlock16(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        vst1q_u8(dst + i, vrev16q_u8(vld1q_u8(src + i)));
+    }
+    return i;
+}
+
+static size_t swapBlock32(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        vst1q_u8(dst + i, vrev32q_u8(vld1q_u8(src + i)));
+    }
+    return i;
+}
+
+#else
+
+static size_t swapBlock16(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    return 0;
+}
+
+static size_t swapBlock32(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    return 0;
+}
+
+#endif
+
+void loadBE16Array(uint16_t* dst, const unsigned char* src, size_t n)
+{
+    size_t i = swapBlock16(reinterpret_cast<unsigned char*>(dst), src, n * 2) / 2;
+    for(; i < n; ++i)
+    {
+        dst[i] = loadBE16(src + i * 2);
+    }
+}
+
+void loadBE32Array(uint32_t* dst, const unsigned char* src, size_t n)
+{
+    size_t i = swapBlock32(reinterpret_cast<unsigned char*>(dst), src, n * 4) / 4;
+    for(; i < n; ++i)
+    {
+        dst[i] = loadBE32(src + i * 4);
+    }
+}
+
+void storeBE16Array(unsigned char* dst, const uint16_t* src, size_t n)
+{
+    size_t i = swapBlock16(dst, reinterpret_cast<const unsigned char*>(src), n * 2) / 2;
+    for(; i < n; ++i)
+    {
+        storeBE16(dst + i * 2, src[i]);
+    }
+}
+
+void storeBE32Array(unsigned char* dst, const uint32_t* src, size_t n)
+{
+    size_t i = swapBlock32(dst, reinterpret_cast<const unsigned char*>(src), n * 4) / 4;
+    for(; i < n; ++i)
+    {
+        storeBE32(dst + i * 4, src[i]);
+    }
+}
+
+NETWORK_END
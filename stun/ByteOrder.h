@@ -0,0 +1,127 @@
+//
+//  ByteOrder.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_BYTE_ORDER_H
+#define NETWORK_BYTE_ORDER_H
+
+#include "Network.h"
+#include <cstring>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#   include <stdlib.h>
+#endif
+
+NETWORK_BEGIN
+
+//
+// Byte swap with compiler builtins
+//
+
+inline uint16_t swap16(uint16_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ushort(v);
+#else
+    return __builtin_bswap16(v);
+#endif
+}
+
+inline uint32_t swap32(uint32_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong(v);
+#else
+    return __builtin_bswap32(v);
+#endif
+}
+
+inline uint64_t swap64(uint64_t v)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+//
+// Convert between host and network byte order (big endian)
+//
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+inline uint16_t hostToBE16(uint16_t v) { return v; }
+inline uint32_t hostToBE32(uint32_t v) { return v; }
+inline uint64_t hostToBE64(uint64_t v) { return v; }
+#else
+inline uint16_t hostToBE16(uint16_t v) { return swap16(v); }
+inline uint32_t hostToBE32(uint32_t v) { return swap32(v); }
+inline uint64_t hostToBE64(uint64_t v) { return swap64(v); }
+#endif
+
+inline uint16_t BE16ToHost(uint16_t v) { return hostToBE16(v); }
+inline uint32_t BE32ToHost(uint32_t v) { return hostToBE32(v); }
+inline uint64_t BE64ToHost(uint64_t v) { return hostToBE64(v); }
+
+//
+// Load and store big endian values at any address
+// memcpy compiles to a plain (unaligned) move
+//
+
+inline uint16_t loadBE16(const unsigned char* p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return BE16ToHost(v);
+}
+
+inline uint32_t loadBE32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return BE32ToHost(v);
+}
+
+inline uint64_t loadBE64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return BE64ToHost(v);
+}
+
+inline void storeBE16(unsigned char* p, uint16_t v)
+{
+    v = hostToBE16(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+inline void storeBE32(unsigned char* p, uint32_t v)
+{
+    v = hostToBE32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+inline void storeBE64(unsigned char* p, uint64_t v)
+{
+    v = hostToBE64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+//
+// Load and store arrays of n big endian values
+// Swapped 16 bytes at a time with SIMD if available
+//
+
+void loadBE16Array(uint16_t* dst, const unsigned char* src, size_t n);
+void loadBE32Array(uint32_t* dst, const unsigned char* src, size_t n);
+
+void storeBE16Array(unsigned char* dst, const uint16_t* src, size_t n);
+void storeBE32Array(unsigned char* dst, const uint32_t* src, size_t n);
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,299 @@
+//
+//  Capture.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Capture.h"
+#include "BufferReader.h"
+
+NETWORK_BEGIN
+
+/*
+ libpcap file format
+ 
+ File header (24 bytes):
+ magic 0xa1b2c3d4 (microseconds) or 0xa1b23c4d (nanoseconds), in the byte
+ order of the capturing host, then version (2 + 2), thiszone, sigfigs,
+ snaplen and link type (4 bytes each)
+ 
+ Record header (16 bytes):
+ seconds, microseconds or nanoseconds, captured length, original length
+ */
+
+#define PCAP_FILE_HEADER_LENGTH     24
+#define PCAP_RECORD_HEADER_LENGTH   16
+
+#define PCAP_MAGIC_MICRO            0xa1b2c3d4
+#define PCAP_MAGIC_NANO             0xa1b23c4d
+
+enum LINK_TYPE
+{
+    LT_NULL         = 0,    // BSD loopback, 4 bytes family
+    LT_ETHERNET     = 1,
+    LT_RAW          = 101,  // IPv4 or IPv6
+    LT_LINUX_SLL    = 113,  // Linux cooked capture, 16 bytes header
+    LT_IPV4         = 228,
+    LT_IPV6         = 229,
+    LT_LINUX_SLL2   = 276   // Linux cooked capture v2, 20 bytes header
+};
+
+#define ETHER_TYPE_IPV4     0x0800
+#define ETHER_TYPE_IPV6     0x86dd
+#define ETHER_TYPE_VLAN     0x8100
+#define ETHER_TYPE_QINQ     0x88a8
+
+#define IP_PROTOCOL_UDP     17
+
+CaptureReader::CaptureReader(const BufferView& data, CAPTURE_FORMAT format)
+: _data(data)
+, _format(format)
+, _failed(false)
+, _swapped(false)
+, _nano(false)
+, _link(0)
+{
+    if(_format == CF_PCAP && !readFileHeader())
+    {
+        _failed = true;
+    }
+}
+
+CaptureReader::~CaptureReader()
+{
+    
+}
+
+bool CaptureReader::readFileHeader()
+{
+    BufferReader r(_data);
+    if(!r.require(PCAP_FILE_HEADER_LENGTH))
+    {
+        return false;
+    }
+    
+    uint32_t magic = r.getBE32();
+    if(magic == PCAP_MAGIC_MICRO || magic == PCAP_MAGIC_NANO)
+    {
+        _swapped = false;
+    }
+    else if(swap32(magic) == PCAP_MAGIC_MICRO || swap32(magic) == PCAP_MAGIC_NANO)
+    {
+        _swapped = true;
+        magic = swap32(magic);
+    }
+    else
+    {
+        return false;
+    }
+    
+    _nano = (magic == PCAP_MAGIC_NANO);
+    r.get(16); // version, thiszone, sigfigs, snaplen
+    _link = _swapped ? swap32(r.getBE32()) : r.getBE32();
+    _data.read(r.consumed());
+    return true;
+}
+
+bool CaptureReader::next(CaptureRecord& record)
+{
+    while(!_failed && _data.readable() > 0)
+    {
+        memset(&record.from, 0, sizeof(record.from));
+        memset(&record.to, 0, sizeof(record.to));
+        record.seconds = 0;
+        record.nanoseconds = 0;
+        
+        BufferReader r(_data);
+        if(_format == CF_LENGTH16)
+        {
+            record.payload = r.view(r.readBE16());
+        }
+        else if(_format == CF_LENGTH32)
+        {
+            record.payload = r.view(r.readBE32());
+        }
+        else if(r.require(PCAP_RECORD_HEADER_LENGTH))
+        {
+            uint32_t seconds = r.getBE32();
+            uint32_t fraction = r.getBE32();
+            uint32_t length = r.getBE32();
+            r.getBE32(); // Original length
+            if(_swapped)
+            {
+                seconds = swap32(seconds);
+                fraction = swap32(fraction);
+                length = swap32(length);
+            }
+            
+            record.seconds = seconds;
+            record.nanoseconds = _nano ? fraction : fraction * 1000;
+            BufferView frame = r.view(length);
+            if(r.good())
+            {
+                _data.read(r.consumed());
+                if(readPacket(record, frame))
+                {
+                    return true;
+                }
+                continue;
+            }
+        }
+        
+        if(r.failed())
+        {
+            _failed = true;
+            return false;
+        }
+        
+        _data.read(r.consumed());
+        return true;
+    }
+    
+    return false;
+}
+
+// Find IP packet in link layer frame
+bool CaptureReader::readPacket(CaptureRecord& record, BufferView frame)
+{
+    BufferReader r(frame);
+    unsigned short type = 0; // Ether type, 0 to tell by IP version
+    switch(_link)
+    {
+        case LT_NULL:
+            r.skip(4);
+            break;
+            
+        case LT_ETHERNET:
+            r.skip(12); // Destination and source MAC
+            type = r.readBE16();
+            while(type == ETHER_TYPE_VLAN || type == ETHER_TYPE_QINQ)
+            {
+                r.skip(2); // Tag
+                type = r.readBE16();
+            }
+            break;
+            
+        case LT_LINUX_SLL:
+            r.skip(14);
+            type = r.readBE16();
+            break;
+            
+        case LT_LINUX_SLL2:
+            type = r.readBE16();
+            r.skip(18);
+            break;
+            
+        case LT_RAW:
+        case LT_IPV4:
+        case LT_IPV6:
+            break;
+            
+        default:
+            return false;
+    }
+    
+    if(r.failed() || (type != 0 && type != ETHER_TYPE_IPV4 && type != ETHER_TYPE_IPV6))
+    {
+        return false;
+    }
+    
+    return readUdp(record, r.view(r.readable()));
+}
+
+// Find UDP datagram in IP packet, fragments are skipped
+bool CaptureReader::readUdp(CaptureRecord& record, BufferView packet)
+{
+    BufferReader r(packet);
+    unsigned char version = r.require(1) ? (*r.read() >> 4) : 0;
+    if(version == 4)
+    {
+        if(!r.require(20))
+        {
+            return false;
+        }
+        
+        size_t headerLength = (r.get8u() & 0x0f) * 4;
+        r.get8u(); // DSCP, ECN
+        size_t totalLength = r.getBE16();
+        r.getBE16(); // Identification
+        unsigned short fragment = r.getBE16();
+        r.get8u(); // TTL
+        unsigned char protocol = r.get8u();
+        r.getBE16(); // Checksum
+        const unsigned char* source = r.get(4);
+        const unsigned char* destination = r.get(4);
+        if(protocol != IP_PROTOCOL_UDP || (fragment & 0x3fff) != 0 ||
+           headerLength < 20 || totalLength < headerLength || !r.skip(headerLength - 20))
+        {
+            return false;
+        }
+        
+        sockaddr_in* from = reinterpret_cast<sockaddr_in*>(&record.from);
+        sockaddr_in* to = reinterpret_cast<sockaddr_in*>(&record.to);
+        from->sin_family = AF_INET;
+        to->sin_family = AF_INET;
+        memcpy(&from->sin_addr, source, 4);
+        memcpy(&to->sin_addr, destination, 4);
+    }
+    else if(version == 6)
+    {
+        if(!r.require(40))
+        {
+            return false;
+        }
+        
+        r.getBE32(); // Version, traffic class, flow label
+        r.getBE16(); // Payload length
+        unsigned char next = r.get8u();
+        r.get8u(); // Hop limit
+        const unsigned char* source = r.get(16);
+        const unsigned char* destination = r.get(16);
+        if(next != IP_PROTOCOL_UDP) // Extension headers are not followed
+        {
+            return false;
+        }
+        
+        sockaddr_in6* from = reinterpret_cast<sockaddr_in6*>(&record.from);
+        sockaddr_in6* to = reinterpret_cast<sockaddr_in6*>(&record.to);
+        from->sin6_family = AF_INET6;
+        to->sin6_family = AF_INET6;
+        memcpy(&from->sin6_addr, source, 16);
+        memcpy(&to->sin6_addr, destination, 16);
+    }
+    else
+    {
+        return false;
+    }
+    
+    // UDP header
+    if(!r.require(8))
+    {
+        return false;
+    }
+    
+    unsigned short sourcePort = r.getBE16();
+    unsigned short destinationPort = r.getBE16();
+    size_t length = r.getBE16();
+    r.getBE16(); // Checksum
+    if(length < 8)
+    {
+        return false;
+    }
+    
+    // Payload may be cut by snap length
+    record.payload = BufferView(r.read(), std::min(length - 8, r.readable()));
+    if(record.from.ss_family == AF_INET)
+    {
+        reinterpret_cast<sockaddr_in*>(&record.from)->sin_port = htons(sourcePort);
+        reinterpret_cast<sockaddr_in*>(&record.to)->sin_port = htons(destinationPort);
+    }
+    else
+    {
+        reinterpret_cast<sockaddr_in6*>(&record.from)->sin6_port = htons(sourcePort);
+        reinterpret_cast<sockaddr_in6*>(&record.to)->sin6_port = htons(destinationPort);
+    }
+    return true;
+}
+
+NETWORK_END
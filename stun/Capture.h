@@ -0,0 +1,80 @@
+//
+//  Capture.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_CAPTURE_H
+#define NETWORK_CAPTURE_H
+
+#include "BufferView.h"
+#include <stdint.h>
+
+NETWORK_BEGIN
+
+//
+// Records of a capture file
+// Payloads are views into the capture, so records of a MappedFile are
+// decoded with no copy
+//
+// network::MappedFile file("stun.pcap");
+// network::CaptureReader reader(file.view(), network::CF_PCAP);
+// network::CaptureRecord record;
+// while(reader.next(record))
+// {
+//     stun::Message* msg = stun::MessageFactory::fromBuffer(&record.payload);
+//     ...
+// }
+//
+
+enum CAPTURE_FORMAT
+{
+    CF_LENGTH16,    // Each record after a 16 bit big endian length
+    CF_LENGTH32,    // Each record after a 32 bit big endian length
+    CF_PCAP         // libpcap file, UDP payloads of IPv4 and IPv6 packets
+};
+
+struct CaptureRecord
+{
+    uint32_t seconds; // Timestamp, 0 if not captured
+    uint32_t nanoseconds;
+    struct sockaddr_storage from; // UDP addresses, AF_UNSPEC if not captured
+    struct sockaddr_storage to;
+    BufferView payload;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader(const BufferView& data, CAPTURE_FORMAT format);
+    ~CaptureReader();
+
+    // Next record, false at end or on a truncated or malformed capture
+    // Packets of pcap that are not UDP, or are fragments, are skipped
+    bool next(CaptureRecord& record);
+
+    // No truncated or malformed data so far
+    bool good() const
+    {
+        return !_failed;
+    }
+
+private:
+    BufferView _data;
+    CAPTURE_FORMAT _format;
+    bool _failed;
+
+    // pcap file header
+    bool _swapped; // Fields are in the other byte order
+    bool _nano; // Timestamps in nanoseconds
+    uint32_t _link; // Link layer type
+
+    bool readFileHeader();
+    bool readPacket(CaptureRecord& record, BufferView frame);
+    bool readUdp(CaptureRecord& record, BufferView packet);
+};
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,104 @@
+//
+//  Crc32.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Crc32.h"
+#include <cstring>
+
+#if defined(__ARM_FEATURE_CRC32)
+#   include <arm_acle.h>
+#endif
+
+NETWORK_BEGIN
+
+#if defined(__ARM_FEATURE_CRC32)
+
+// ARMv8 CRC32 instructions use the same polynomial
+uint32_t crc32(const unsigned char* b, size_t n, uint32_t crc)
+{
+    crc = ~crc;
+    for(; n >= 8; b += 8, n -= 8)
+    {
+        uint64_t v;
+        memcpy(&v, b, 8);
+        crc = __crc32d(crc, v);
+    }
+    for(; n > 0; ++b, --n)
+    {
+        crc = __crc32b(crc, *b);
+    }
+    return ~crc;
+}
+
+#else
+
+//
+// Slice-by-8, 8 bytes per step through 8 tables of 256 entries
+// Table k is the CRC of a byte followed by k zero bytes
+//
+
+#define CRC32_POLYNOMIAL 0xEDB88320 // Reflected 0x04C11DB7
+
+struct Crc32Table
+{
+    uint32_t t[8][256];
+    
+    Crc32Table()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? (c >> 1) ^ CRC32_POLYNOMIAL : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            for(int k = 1; k < 8; ++k)
+            {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+static const Crc32Table& table()
+{
+    static const Crc32Table table;
+    return table;
+}
+
+uint32_t crc32(const unsigned char* b, size_t n, uint32_t crc)
+{
+    const uint32_t (*t)[256] = table().t;
+    crc = ~crc;
+    
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    for(; n >= 8; b += 8, n -= 8)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, b, 4);
+        memcpy(&hi, b + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+#endif
+    
+    // Tail, or all bytes on big endian host
+    for(; n > 0; ++b, --n)
+    {
+        crc = t[0][(crc ^ *b) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif
+
+NETWORK_END
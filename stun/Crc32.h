@@ -0,0 +1,29 @@
+//
+//  Crc32.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_CRC32_H
+#define NETWORK_CRC32_H
+
+#include "Network.h"
+#include <stdint.h>
+#include <cstddef>
+
+NETWORK_BEGIN
+
+//
+// CRC-32 of ISO 3309 / ITU-T V.42 (as zlib and RFC 5389 FINGERPRINT)
+// Pass the result of a previous call as crc to continue over more bytes
+//
+// uint32_t crc = network::crc32(header, 20);
+// crc = network::crc32(body, n, crc);
+//
+
+uint32_t crc32(const unsigned char* b, size_t n, uint32_t crc = 0);
+
+NETWORK_END
+
+#endif
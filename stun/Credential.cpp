@@ -0,0 +1,49 @@
+//
+//  Credential.cpp
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Credential.h"
+
+STUN_BEGIN
+
+Credential::Credential(const std::string& username, const std::string& password)
+: _username(username)
+, _longTerm(false)
+, _hmac(reinterpret_cast<const unsigned char*>(password.data()), password.size())
+{
+    
+}
+
+Credential::Credential(const std::string& username, const std::string& realm, const std::string& password)
+: _username(username)
+, _realm(realm)
+, _longTerm(true)
+{
+    unsigned char key[MD5_DIGEST_LENGTH];
+    longTermKey(username, realm, password, key);
+    _hmac.setKey(key, sizeof(key));
+}
+
+Credential::~Credential()
+{
+    
+}
+
+void Credential::longTermKey(const std::string& username,
+                             const std::string& realm,
+                             const std::string& password,
+                             unsigned char* key)
+{
+    network::Md5 md5;
+    md5.update(reinterpret_cast<const unsigned char*>(username.data()), username.size());
+    md5.update(reinterpret_cast<const unsigned char*>(":"), 1);
+    md5.update(reinterpret_cast<const unsigned char*>(realm.data()), realm.size());
+    md5.update(reinterpret_cast<const unsigned char*>(":"), 1);
+    md5.update(reinterpret_cast<const unsigned char*>(password.data()), password.size());
+    md5.final(key);
+}
+
+STUN_END
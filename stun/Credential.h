@@ -0,0 +1,80 @@
+//
+//  Credential.h
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef STUN_CREDENTIAL_H
+#define STUN_CREDENTIAL_H
+
+#include <stun/Config.h>
+#include <stun/Digest.h>
+#include <string>
+
+STUN_BEGIN
+
+/*
+ RFC 5389
+ 15.4.  MESSAGE-INTEGRITY
+ The key for the HMAC depends on whether long-term or short-term
+ credentials are in use.  For long-term credentials, the key is 16
+ bytes:
+ 
+ key = MD5(username ":" realm ":" SASLprep(password))
+ 
+ For short-term credentials:
+ 
+ key = SASLprep(password)
+ 
+ The MD5 key and the HMAC pad states are computed once for a
+ credential, so keep it for as long as the password is valid.
+ 
+ Passwords are used as given, SASLprep is up to the caller (it leaves
+ ASCII passwords unchanged).
+ */
+
+class Credential
+{
+public:
+    Credential(const std::string& username, const std::string& password); // Short-term
+    Credential(const std::string& username, const std::string& realm, const std::string& password); // Long-term
+    ~Credential();
+    
+    const std::string& username() const
+    {
+        return _username;
+    }
+    
+    const std::string& realm() const
+    {
+        return _realm;
+    }
+    
+    bool isLongTerm() const
+    {
+        return _longTerm;
+    }
+    
+    // HMAC-SHA1 with the key of credential
+    const network::HmacSha1& hmac() const
+    {
+        return _hmac;
+    }
+    
+private:
+    std::string _username;
+    std::string _realm;
+    bool _longTerm;
+    network::HmacSha1 _hmac;
+    
+    // MD5 key of long-term credential
+    static void longTermKey(const std::string& username,
+                            const std::string& realm,
+                            const std::string& password,
+                            unsigned char* key);
+};
+
+STUN_END
+
+#endif
@@ -0,0 +1,165 @@
+//
+//  DatagramBatch.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "DatagramBatch.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+NETWORK_BEGIN
+
+DatagramBatch::DatagramBatch(size_t capacity, size_t size)
+: _memory(capacity * size)
+, _size(size)
+, _count(0)
+, _sizes(capacity)
+, _addresses(capacity)
+{
+    assert(capacity > 0 && size > 0);
+#if defined(__linux)
+    _headers.resize(capacity);
+    _vectors.resize(capacity);
+    _control.resize(capacity * CMSG_SPACE(sizeof(uint32_t)));
+    memset(&_headers[0], 0, capacity * sizeof(struct mmsghdr));
+    for(size_t i = 0; i < capacity; ++i)
+    {
+        _vectors[i].iov_base = &_memory[i * _size];
+        _vectors[i].iov_len = _size;
+        _headers[i].msg_hdr.msg_iov = &_vectors[i];
+        _headers[i].msg_hdr.msg_iovlen = 1;
+        _headers[i].msg_hdr.msg_name = &_addresses[i];
+    }
+#endif
+}
+
+DatagramBatch::~DatagramBatch()
+{
+    
+}
+
+bool DatagramBatch::add(const unsigned char* b, size_t n, const struct sockaddr_in& to)
+{
+    if(full() || n > _size)
+    {
+        return false;
+    }
+    
+    memcpy(&_memory[_count * _size], b, n);
+    _sizes[_count] = n;
+    _addresses[_count] = to;
+    ++_count;
+    return true;
+}
+
+// Return number of datagrams sent, -1 if none could be sent
+ssize_t DatagramBatch::sendTo(SOCKET fd)
+{
+    size_t sent = 0;
+#if defined(__linux)
+    // Headers may hold control data of a previous receive, which
+    // sendmmsg would reject
+    for(size_t i = 0; i < _count; ++i)
+    {
+        _vectors[i].iov_len = _sizes[i];
+        _headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        _headers[i].msg_hdr.msg_control = NULL;
+        _headers[i].msg_hdr.msg_controllen = 0;
+        _headers[i].msg_hdr.msg_flags = 0;
+    }
+    
+    // The kernel may take a part of batch, send the rest again
+    while(sent < _count)
+    {
+        int rc = ::sendmmsg(fd, &_headers[sent], static_cast<unsigned int>(_count - sent), 0);
+        if(rc <= 0)
+        {
+            if(rc < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        sent += rc;
+    }
+#else
+    while(sent < _count)
+    {
+        ssize_t rc = ::sendto(fd, reinterpret_cast<const char*>(data(sent)), _sizes[sent], 0,
+                              reinterpret_cast<const struct sockaddr*>(&_addresses[sent]), sizeof(struct sockaddr_in));
+        if(rc < 0)
+        {
+            break;
+        }
+        ++sent;
+    }
+#endif
+    return sent > 0 || _count == 0 ? static_cast<ssize_t>(sent) : -1;
+}
+
+// Return number of datagrams received, -1 if failed
+ssize_t DatagramBatch::receiveFrom(SOCKET fd, uint32_t* drops)
+{
+    _count = 0;
+#if defined(__linux)
+    size_t n = capacity();
+    size_t space = CMSG_SPACE(sizeof(uint32_t));
+    for(size_t i = 0; i < n; ++i)
+    {
+        _vectors[i].iov_len = _size;
+        _headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        _headers[i].msg_hdr.msg_control = drops != NULL ? &_control[i * space] : NULL;
+        _headers[i].msg_hdr.msg_controllen = drops != NULL ? space : 0;
+    }
+    
+    // Wait for the first datagram only, then take what is queued
+    int rc = ::recvmmsg(fd, &_headers[0], static_cast<unsigned int>(n), MSG_WAITFORONE, NULL);
+    if(rc < 0)
+    {
+        return -1;
+    }
+    for(int i = 0; i < rc; ++i)
+    {
+        _sizes[i] = _headers[i].msg_len;
+        if(drops != NULL)
+        {
+            *drops = std::max(*drops, dropCount(&_headers[i].msg_hdr));
+        }
+    }
+    _count = rc;
+#else
+    while(!full())
+    {
+        // Wait for the first datagram only, then take what is queued
+        // Windows has no per-call non-blocking flag, so one at a time
+        int flags = 0;
+        if(_count > 0)
+        {
+#if defined(_WIN32)
+            break;
+#else
+            flags = MSG_DONTWAIT;
+#endif
+        }
+        
+        socklen_t len = sizeof(struct sockaddr_in);
+        ssize_t rc = ::recvfrom(fd, reinterpret_cast<char*>(&_memory[_count * _size]), _size, flags,
+                                reinterpret_cast<struct sockaddr*>(&_addresses[_count]), &len);
+        if(rc < 0)
+        {
+            if(_count == 0)
+            {
+                return -1;
+            }
+            break;
+        }
+        _sizes[_count++] = rc;
+    }
+#endif
+    return static_cast<ssize_t>(_count);
+}
+
+NETWORK_END
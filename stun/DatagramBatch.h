@@ -0,0 +1,122 @@
+//
+//  DatagramBatch.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_DATAGRAM_BATCH_H
+#define NETWORK_DATAGRAM_BATCH_H
+
+#include "Network.h"
+#include "BufferView.h"
+#include <vector>
+
+NETWORK_BEGIN
+
+//
+// Preallocated slots of datagrams, each with its own address and length
+// A batch is sent or received with one system call (sendmmsg, recvmmsg)
+// where the system has them, else with a call per datagram
+// Slots are allocated once, so a batch is reused with no allocation
+//
+// network::DatagramBatch batch(64);
+// for(...) batch.add(request.data(), request.size(), server);
+// socket.write(&batch);
+// ...
+// socket.read(&batch, 200);
+// for(size_t i = 0; i < batch.count(); ++i) match(batch.view(i), batch.address(i));
+//
+
+class DatagramBatch
+{
+public:
+    DatagramBatch(size_t capacity = 32, size_t size = MAX_DATAGRAM_SIZE); // Number of slots, size of a slot
+    ~DatagramBatch();
+    
+    // Number of slots
+    size_t capacity() const
+    {
+        return _addresses.size();
+    }
+    
+    // Number of datagrams in batch
+    size_t count() const
+    {
+        return _count;
+    }
+    
+    // Max length of a datagram
+    size_t slotSize() const
+    {
+        return _size;
+    }
+    
+    bool full() const
+    {
+        return _count == capacity();
+    }
+    
+    void clear()
+    {
+        _count = 0;
+    }
+    
+    // Copy a datagram to the next free slot
+    // Return false if the batch is full or the datagram is too long
+    bool add(const unsigned char* b, size_t n, const struct sockaddr_in& to);
+    
+    //
+    // Datagram i of batch
+    // To address for sending, from address after receiving
+    //
+    
+    const unsigned char* data(size_t i) const
+    {
+        return &_memory[i * _size];
+    }
+    
+    size_t size(size_t i) const
+    {
+        return _sizes[i];
+    }
+    
+    BufferView view(size_t i) const
+    {
+        return BufferView(data(i), size(i));
+    }
+    
+    const struct sockaddr_in& address(size_t i) const
+    {
+        return _addresses[i];
+    }
+    
+private:
+    std::vector<unsigned char> _memory; // capacity() slots of _size bytes
+    size_t _size;
+    size_t _count;
+    std::vector<size_t> _sizes;
+    std::vector<struct sockaddr_in> _addresses;
+    
+#if defined(__linux)
+    // Headers of sendmmsg and recvmmsg, pointing to the slots
+    std::vector<struct mmsghdr> _headers;
+    std::vector<struct iovec> _vectors;
+    std::vector<unsigned char> _control; // Drop count of each datagram
+#endif
+    
+    // Send count() datagrams, or receive up to capacity() datagrams,
+    // the first one waited for if blocking
+    // Kernel drop count is updated if drops is not NULL
+    ssize_t sendTo(SOCKET fd);
+    ssize_t receiveFrom(SOCKET fd, uint32_t* drops = NULL);
+    
+    friend class UdpSocket;
+    
+    DatagramBatch(const DatagramBatch&);
+    DatagramBatch& operator=(const DatagramBatch&);
+};
+
+NETWORK_END
+
+#endif
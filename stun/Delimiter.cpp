@@ -0,0 +1,155 @@
+//
+//  Delimiter.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Delimiter.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+NETWORK_BEGIN
+
+// Index of lowest set bit, v is not 0
+static inline unsigned lowestBit(uint32_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return i;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+DelimiterSet::DelimiterSet(char delim)
+{
+    init(&delim, 1);
+}
+
+DelimiterSet::DelimiterSet(const std::string& delims)
+{
+    init(delims.data(), delims.size());
+}
+
+DelimiterSet::DelimiterSet(const char* delims, size_t n)
+{
+    init(delims, n);
+}
+
+void DelimiterSet::init(const char* delims, size_t n)
+{
+    memset(_bits, 0, sizeof(_bits));
+    _count = 0;
+    _length = n;
+    for(size_t i = 0; i < n; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(delims[i]);
+        if(contains(c))
+        {
+            continue;
+        }
+        
+        _bits[c >> 5] |= 1u << (c & 31);
+        if(_count < MAX_SIMD_DELIMITERS)
+        {
+            _chars[_count] = c;
+        }
+        ++_count;
+    }
+}
+
+const char* DelimiterSet::findScalar(const char* begin, const char* end) const
+{
+    for(const char* p = begin; p < end; ++p)
+    {
+        if(contains(static_cast<unsigned char>(*p)))
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char* DelimiterSet::find(const char* begin, const char* end) const
+{
+    if(_count == 0)
+    {
+        return end;
+    }
+    
+    if(_count == 1)
+    {
+        const void* p = memchr(begin, _chars[0], end - begin);
+        return p != NULL ? static_cast<const char*>(p) : end;
+    }
+    
+    if(_count > MAX_SIMD_DELIMITERS)
+    {
+        return findScalar(begin, end);
+    }
+    
+    const char* p = begin;
+    
+#if defined(__AVX2__)
+    __m256i chars32[MAX_SIMD_DELIMITERS];
+    for(size_t i = 0; i < _count; ++i)
+    {
+        chars32[i] = _mm256_set1_epi8(static_cast<char>(_chars[i]));
+    }
+    
+    for(; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_cmpeq_epi8(v, chars32[0]);
+        for(size_t i = 1; i < _count; ++i)
+        {
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, chars32[i]));
+        }
+        
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+        if(mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+#endif
+    
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    __m128i chars16[MAX_SIMD_DELIMITERS];
+    for(size_t i = 0; i < _count; ++i)
+    {
+        chars16[i] = _mm_set1_epi8(static_cast<char>(_chars[i]));
+    }
+    
+    for(; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m = _mm_cmpeq_epi8(v, chars16[0]);
+        for(size_t i = 1; i < _count; ++i)
+        {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, chars16[i]));
+        }
+        
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(m));
+        if(mask != 0)
+        {
+            return p + lowestBit(mask);
+        }
+    }
+#endif
+    
+    return findScalar(p, end);
+}
+
+NETWORK_END
@@ -0,0 +1,64 @@
+//
+//  Delimiter.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_DELIMITER_H
+#define NETWORK_DELIMITER_H
+
+#include "Network.h"
+#include <string>
+#include <stdint.h>
+
+NETWORK_BEGIN
+
+//
+// Set of delimiter chars to scan text for
+// The set is built once, then scans 16 or 32 bytes at a time with
+// SSE2 or AVX2 if available, one byte at a time otherwise
+//
+// network::DelimiterSet delim("\r\n");
+// const char* p = delim.find(begin, end); // First '\r' or '\n', or end
+//
+// Build a set once for repeated reads, and pass it to readString()
+// or peekString() of Buffer and BufferView
+//
+
+#define MAX_SIMD_DELIMITERS 16
+
+class DelimiterSet
+{
+public:
+    explicit DelimiterSet(char delim);
+    explicit DelimiterSet(const std::string& delims);
+    DelimiterSet(const char* delims, size_t n);
+
+    bool contains(unsigned char c) const
+    {
+        return (_bits[c >> 5] >> (c & 31)) & 1;
+    }
+
+    // Bytes a delimiter takes in the text, the length the set was built from
+    size_t length() const
+    {
+        return _length;
+    }
+
+    // First char in [begin, end) that is in the set, or end
+    const char* find(const char* begin, const char* end) const;
+
+private:
+    uint32_t _bits[8]; // 256 bit set
+    unsigned char _chars[MAX_SIMD_DELIMITERS]; // Distinct chars for SIMD compare
+    size_t _count; // Number of distinct chars
+    size_t _length; // Length of the delimiter
+
+    void init(const char* delims, size_t n);
+    const char* findScalar(const char* begin, const char* end) const;
+};
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,337 @@
+//
+//  Digest.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Digest.h"
+#include "ByteOrder.h"
+#include <cstring>
+
+NETWORK_BEGIN
+
+static inline uint32_t rotl(uint32_t v, int n)
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+static inline uint32_t loadLE32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline void storeLE32(unsigned char* p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// FIPS 180-4
+Sha1::Sha1()
+: _length(0)
+{
+    _state[0] = 0x67452301;
+    _state[1] = 0xEFCDAB89;
+    _state[2] = 0x98BADCFE;
+    _state[3] = 0x10325476;
+    _state[4] = 0xC3D2E1F0;
+}
+
+void Sha1::update(const unsigned char* b, size_t n)
+{
+    size_t used = _length % DIGEST_BLOCK_LENGTH;
+    _length += n;
+    
+    // Fill partial block
+    if(used > 0)
+    {
+        size_t k = DIGEST_BLOCK_LENGTH - used;
+        if(n < k)
+        {
+            memcpy(_block + used, b, n);
+            return;
+        }
+        memcpy(_block + used, b, k);
+        compress(_block);
+        b += k;
+        n -= k;
+    }
+    
+    // Whole blocks from input
+    for(; n >= DIGEST_BLOCK_LENGTH; b += DIGEST_BLOCK_LENGTH, n -= DIGEST_BLOCK_LENGTH)
+    {
+        compress(b);
+    }
+    memcpy(_block, b, n);
+}
+
+void Sha1::final(unsigned char* digest)
+{
+    uint64_t bits = _length * 8;
+    size_t used = _length % DIGEST_BLOCK_LENGTH;
+    
+    // 0x80, zeros, then 64 bits length
+    unsigned char pad[DIGEST_BLOCK_LENGTH * 2];
+    size_t n = (used < 56 ? 56 : 120) - used;
+    memset(pad, 0, n);
+    pad[0] = 0x80;
+    storeBE64(pad + n, bits);
+    update(pad, n + 8);
+    
+    for(int i = 0; i < 5; ++i)
+    {
+        storeBE32(digest + i * 4, _state[i]);
+    }
+}
+
+void Sha1::compress(const unsigned char* block)
+{
+    uint32_t w[80];
+    for(int i = 0; i < 16; ++i)
+    {
+        w[i] = loadBE32(block + i * 4);
+    }
+    for(int i = 16; i < 80; ++i)
+    {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    
+    uint32_t a = _state[0];
+    uint32_t b = _state[1];
+    uint32_t c = _state[2];
+    uint32_t d = _state[3];
+    uint32_t e = _state[4];
+    for(int i = 0; i < 80; ++i)
+    {
+        uint32_t f;
+        uint32_t k;
+        if(i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if(i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if(i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// RFC 1321
+Md5::Md5()
+: _length(0)
+{
+    _state[0] = 0x67452301;
+    _state[1] = 0xEFCDAB89;
+    _state[2] = 0x98BADCFE;
+    _state[3] = 0x10325476;
+}
+
+void Md5::update(const unsigned char* b, size_t n)
+{
+    size_t used = _length % DIGEST_BLOCK_LENGTH;
+    _length += n;
+    
+    // Fill partial block
+    if(used > 0)
+    {
+        size_t k = DIGEST_BLOCK_LENGTH - used;
+        if(n < k)
+        {
+            memcpy(_block + used, b, n);
+            return;
+        }
+        memcpy(_block + used, b, k);
+        compress(_block);
+        b += k;
+        n -= k;
+    }
+    
+    // Whole blocks from input
+    for(; n >= DIGEST_BLOCK_LENGTH; b += DIGEST_BLOCK_LENGTH, n -= DIGEST_BLOCK_LENGTH)
+    {
+        compress(b);
+    }
+    memcpy(_block, b, n);
+}
+
+void Md5::final(unsigned char* digest)
+{
+    uint64_t bits = _length * 8;
+    size_t used = _length % DIGEST_BLOCK_LENGTH;
+    
+    // 0x80, zeros, then 64 bits length in little endian
+    unsigned char pad[DIGEST_BLOCK_LENGTH * 2];
+    size_t n = (used < 56 ? 56 : 120) - used;
+    memset(pad, 0, n);
+    pad[0] = 0x80;
+    storeLE32(pad + n, static_cast<uint32_t>(bits));
+    storeLE32(pad + n + 4, static_cast<uint32_t>(bits >> 32));
+    update(pad, n + 8);
+    
+    for(int i = 0; i < 4; ++i)
+    {
+        storeLE32(digest + i * 4, _state[i]);
+    }
+}
+
+void Md5::compress(const unsigned char* block)
+{
+    static const uint32_t K[64] =
+    {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+    };
+    static const int S[64] =
+    {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+    };
+    
+    uint32_t m[16];
+    for(int i = 0; i < 16; ++i)
+    {
+        m[i] = loadLE32(block + i * 4);
+    }
+    
+    uint32_t a = _state[0];
+    uint32_t b = _state[1];
+    uint32_t c = _state[2];
+    uint32_t d = _state[3];
+    for(int i = 0; i < 64; ++i)
+    {
+        uint32_t f;
+        int g;
+        if(i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if(i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        }
+        else if(i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        uint32_t t = d;
+        d = c;
+        c = b;
+        b = b + rotl(a + f + K[i] + m[g], S[i]);
+        a = t;
+    }
+    
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+HmacSha1::HmacSha1()
+{
+    setKey(NULL, 0);
+}
+
+HmacSha1::HmacSha1(const unsigned char* key, size_t n)
+{
+    setKey(key, n);
+}
+
+// Hash the key padded with ipad and opad, once for all MACs
+void HmacSha1::setKey(const unsigned char* key, size_t n)
+{
+    unsigned char k[DIGEST_BLOCK_LENGTH];
+    memset(k, 0, sizeof(k));
+    if(n > DIGEST_BLOCK_LENGTH)
+    {
+        Sha1 sha;
+        sha.update(key, n);
+        sha.final(k);
+    }
+    else if(n > 0)
+    {
+        memcpy(k, key, n);
+    }
+    
+    unsigned char pad[DIGEST_BLOCK_LENGTH];
+    for(size_t i = 0; i < DIGEST_BLOCK_LENGTH; ++i)
+    {
+        pad[i] = k[i] ^ 0x36;
+    }
+    _inner = Sha1();
+    _inner.update(pad, sizeof(pad));
+    
+    for(size_t i = 0; i < DIGEST_BLOCK_LENGTH; ++i)
+    {
+        pad[i] = k[i] ^ 0x5c;
+    }
+    _outer = Sha1();
+    _outer.update(pad, sizeof(pad));
+}
+
+void HmacSha1::end(Sha1& sha, unsigned char* mac) const
+{
+    unsigned char digest[SHA1_DIGEST_LENGTH];
+    sha.final(digest);
+    
+    Sha1 outer = _outer;
+    outer.update(digest, sizeof(digest));
+    outer.final(mac);
+}
+
+void HmacSha1::sign(const unsigned char* b, size_t n, unsigned char* mac) const
+{
+    Sha1 sha = begin();
+    sha.update(b, n);
+    end(sha, mac);
+}
+
+NETWORK_END
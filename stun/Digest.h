@@ -0,0 +1,102 @@
+//
+//  Digest.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_DIGEST_H
+#define NETWORK_DIGEST_H
+
+#include "Network.h"
+#include <stdint.h>
+#include <cstddef>
+
+NETWORK_BEGIN
+
+//
+// Message digests, as used by STUN authentication
+// A digest is a value type, a copy of a partial state continues from it
+//
+// network::Sha1 sha;
+// sha.update(b, n);
+// unsigned char digest[SHA1_DIGEST_LENGTH];
+// sha.final(digest);
+//
+
+#define SHA1_DIGEST_LENGTH 20
+#define MD5_DIGEST_LENGTH 16
+#define DIGEST_BLOCK_LENGTH 64
+
+class Sha1
+{
+public:
+    Sha1();
+    
+    void update(const unsigned char* b, size_t n);
+    void final(unsigned char* digest); // SHA1_DIGEST_LENGTH bytes
+    
+private:
+    uint32_t _state[5];
+    uint64_t _length; // Bytes hashed so far
+    unsigned char _block[DIGEST_BLOCK_LENGTH]; // Partial block
+    
+    void compress(const unsigned char* block);
+};
+
+class Md5
+{
+public:
+    Md5();
+    
+    void update(const unsigned char* b, size_t n);
+    void final(unsigned char* digest); // MD5_DIGEST_LENGTH bytes
+    
+private:
+    uint32_t _state[4];
+    uint64_t _length; // Bytes hashed so far
+    unsigned char _block[DIGEST_BLOCK_LENGTH]; // Partial block
+    
+    void compress(const unsigned char* block);
+};
+
+//
+// HMAC-SHA1 (RFC 2104) with precomputed key state
+// The inner and outer pad blocks are hashed once for a key, so a MAC
+// costs the message plus two more compressions
+//
+// network::HmacSha1 hmac(key, n);
+// network::Sha1 sha = hmac.begin();
+// sha.update(header, 20);
+// sha.update(body, n);
+// hmac.end(sha, mac);
+//
+
+class HmacSha1
+{
+public:
+    HmacSha1();
+    HmacSha1(const unsigned char* key, size_t n);
+    
+    void setKey(const unsigned char* key, size_t n);
+    
+    // Digest of the inner pad, to be updated with the message
+    Sha1 begin() const
+    {
+        return _inner;
+    }
+    
+    // Finish a digest returned by begin()
+    void end(Sha1& sha, unsigned char* mac) const; // SHA1_DIGEST_LENGTH bytes
+    
+    // MAC of n bytes at b
+    void sign(const unsigned char* b, size_t n, unsigned char* mac) const;
+    
+private:
+    Sha1 _inner;
+    Sha1 _outer;
+};
+
+NETWORK_END
+
+#endif
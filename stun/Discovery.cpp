@@ -9,6 +9,7 @@
 #include "Discovery.h"
 #include <stun/Buffer.h>
 #include <iostream>
+#include <algorithm>
 
 STUN_BEGIN
 
@@ -17,8 +18,13 @@ Discovery::Discovery(const std::string& host, unsigned short port, int timeout)
 , _port(port)
 , _timeout(timeout)
 , _socket(host, port)
+, _error(0)
 {
-
+    if(_socket.valid())
+    {
+        _socket.setReceiveBufferSize(DISCOVERY_RECEIVE_BUFFER);
+        _socket.setDropCounter();
+    }
 }
 
 Discovery::~Discovery()
@@ -62,31 +68,48 @@ bool Discovery::isSameAddress(const struct sockaddr_in& a, const struct sockaddr
 }
 
 
-// Send stun request mesage
-void Discovery::sendMessage(Message* msg)
+// Send encoded binding request as is
+void Discovery::sendRequest(const BindingTemplate& request)
+{
+    _socket.write(request.data(), request.size());
+    sent(request.tid());
+}
+
+// Record the send time of a request, a new transaction on first send
+Transaction* Discovery::sent(const network::UUID& tid)
 {
-    assert(msg != NULL);
-    //std::cout << ">> " << msg->toString() << "\n";
-    _tid = msg->tid();
-    network::Buffer buf;
-    msg->toBuffer(&buf);
-    _socket.write(buf.read(), buf.readable());
+    Transaction* t = _transactions.find(tid);
+    if(t == NULL)
+    {
+        t = _transactions.insert(tid);
+    }
+    t->send(TransactionTable::now());
+    return t;
 }
 
+// Response of an outstanding request, or NULL if timeout
+// Datagrams matching no transaction are dropped before decoding
+// Responses may exceed the 576 bytes of a request, so room for a full datagram
 Message* Discovery::receiveMessage(int timeout)
 {
-    network::Buffer buf;
-    buf.reserve(512);
+    network::InlineBuffer<MAX_DATAGRAM_SIZE> buf;
     long len = _socket.read(buf.write(), buf.writable(), timeout);
     if(len > 0)
     {
         buf.write(len);
-        Message* msg = MessageFactory::fromBuffer(&buf);
-        //std::cout << "<< " << msg->toString() << "\n";
-        if(msg != NULL && msg->tid() == _tid)
+        if(Message::classify(buf.read(), buf.readable()) == MV_NONE)
         {
-            return msg;
+            return NULL;
         }
+        
+        if(_transactions.find(buf.read() + 4) == NULL)
+        {
+            return NULL;
+        }
+        
+        Message* msg = MessageFactory::fromBuffer(&buf, true); // Only addresses are read
+        //std::cout << "<< " << msg->toString() << "\n";
+        return msg;
     }
     return NULL;
 }
@@ -189,11 +212,22 @@ Message* Discovery::receiveMessage(int timeout)
 
 void Discovery::discover()
 {
+    if(!_socket.valid())
+    {
+        std::cout << "No UDP socket, can not tell the NAT type.\n";
+        return;
+    }
+    
     // TEST I
     // Send binding request with no change address request attribute
     setRemoteAddress(_host, _port);
     std::cout << "TEST I to " << network::addressToString(remoteAddress()) << "\n";
     BindingResponse* t1_response = binding();
+    if(t1_response == NULL && rejected("TEST I"))
+    {
+        return;
+    }
+    
     if(t1_response == NULL) // TEST I -> No Response
     {
         std::cout << "TEST I -> No Response.\n";
@@ -209,6 +243,11 @@ void Discovery::discover()
             // TEST II
             std::cout << "TEST II to " << network::addressToString(remoteAddress()) << "\n";
             BindingResponse* t2_response = binding(true, true);
+            if(t2_response == NULL && rejected("TEST II"))
+            {
+                return;
+            }
+            
             if(t2_response == NULL) // TEST II -> No Response
             {
                 std::cout << "TEST II -> No Response.\n";
@@ -226,6 +265,11 @@ void Discovery::discover()
             // TEST II
             std::cout << "TEST II to " << network::addressToString(remoteAddress()) << "\n";
             BindingResponse* t2_response = binding(true, true);
+            if(t2_response == NULL && rejected("TEST II"))
+            {
+                return;
+            }
+            
             if(t2_response != NULL) // TEST II -> Yes Response
             {
                 std::cout << "TEST II -> Yes Response.\n";
@@ -239,6 +283,11 @@ void Discovery::discover()
                 _socket.setRemoteAddress(t1_response->changedAddress());
                 std::cout << "TEST I again to " << network::addressToString(remoteAddress()) << "\n";
                 BindingResponse* t12_response = binding();
+                if(t12_response == NULL && rejected("TEST I again"))
+                {
+                    return;
+                }
+                
                 if(t12_response == NULL) // TEST I(2) -> No Response
                 {
                     assert(false);
@@ -260,6 +309,11 @@ void Discovery::discover()
                         // TEST III
                         std::cout << "TEST III to " << network::addressToString(remoteAddress()) << "\n";
                         BindingResponse* t3_response = binding(true);
+                        if(t3_response == NULL && rejected("TEST III"))
+                        {
+                            return;
+                        }
+                        
                         if(t3_response != NULL) // TEST III -> Yes Response
                         {
                             std::cout << "TEST III -> Yes Response.\n";
@@ -279,28 +333,81 @@ void Discovery::discover()
 
 BindingResponse* Discovery::binding(bool portChange, bool ipChange)
 {
-    BindingRequest request;
-    if(ipChange || portChange)
-    {
-        request.setChangeRequest(portChange, ipChange);
-    }
-    sendMessage(&request);
+    // Encoded once, retransmits send the same bytes
+    BindingTemplate request(portChange, ipChange);
+    network::UUID tid = Message::newTid();
+    request.setTid(tid);
+    sendRequest(request);
     
-    // Receive and resend every 200 ms until timeout
-    Message* response = NULL;
-    for(int i = 0; i < _timeout/200; i++)
+    // Resend every 200 ms until timeout, timed by send timestamps,
+    // so unmatched datagrams do not trigger early resends
+    const int64_t interval = 200 * 1000;
+    int64_t deadline = _transactions.find(tid)->sent + static_cast<int64_t>(_timeout) * 1000;
+    BindingResponse* success = NULL;
+    uint32_t drops = _socket.drops();
+    _error = 0;
+    for(;;)
     {
-        response = receiveMessage(200);
+        int64_t now = TransactionTable::now();
+        if(now >= deadline)
+        {
+            break;
+        }
+        
+        Transaction* t = _transactions.find(tid);
+        if(now - t->resent >= interval)
+        {
+            sendRequest(request);
+            continue;
+        }
+        
+        int64_t wait = std::min(t->resent + interval, deadline) - now;
+        Message* response = receiveMessage(static_cast<int>((wait + 999) / 1000));
         if(response == NULL)
         {
-            sendMessage(&request);
+            continue;
+        }
+        
+        success = dynamic_cast<BindingResponse*>(response);
+        if(success != NULL)
+        {
+            break;
         }
-        else
+        
+        // A definitive error ends the transaction at once,
+        // keep waiting on a transient or malformed one
+        BindingErrorResponse* error = dynamic_cast<BindingErrorResponse*>(response);
+        if(error != NULL && error->isDefinitive())
         {
+            _error = error->errorCode();
+            std::cout << "Error " << _error << " " << error->errorReason() << "\n";
+            delete error;
             break;
         }
+        delete response;
+    }
+    _transactions.remove(tid);
+    
+    // Drops are reported with the next datagram read, so only drops
+    // before the last read are known
+    if(success == NULL && _error == 0 && _socket.drops() > drops)
+    {
+        std::cout << "Kernel dropped " << _socket.drops() - drops << " datagrams, the response may be lost.\n";
     }
-    return dynamic_cast<BindingResponse*>(response);
+    return success;
+}
+
+// The server rejected a test, so the NAT type can not be told
+bool Discovery::rejected(const std::string& test)
+{
+    if(_error == 0)
+    {
+        return false;
+    }
+    
+    std::cout << test << " -> Error " << _error << ".\n";
+    std::cout << "Server rejected the request, can not tell the NAT type.\n";
+    return true;
 }
 
 STUN_END
@@ -11,6 +11,8 @@
 
 #include <stun/Config.h>
 #include <stun/Message.h>
+#include <stun/BindingTemplate.h>
+#include <stun/TransactionTable.h>
 #include <stun/Network.h>
 
 STUN_BEGIN
@@ -32,6 +34,9 @@ STUN_BEGIN
  o  Restricted cone or restricted port cone NAT
  */
 
+// Room for bursts of replies, so they are not dropped and taken for no response
+#define DISCOVERY_RECEIVE_BUFFER (256 * 1024)
+
 class Discovery
 {
 public:
@@ -48,10 +53,12 @@ private:
     bool isLocalAddress(const struct sockaddr_in& sin);
     bool isSameAddress(const struct sockaddr_in& a, const struct sockaddr_in& b);
     
-    void sendMessage(Message* msg);
+    void sendRequest(const BindingTemplate& request);
+    Transaction* sent(const network::UUID& tid);
     Message* receiveMessage(int timeout);
 
     BindingResponse* binding(bool portChange = false, bool ipChange = false);
+    bool rejected(const std::string& test);
 
 private: 
     std::string _host;
@@ -61,8 +68,11 @@ private:
     // UDP socket
     network::UdpSocket _socket;
     
-    // Transaction ID of last request, discard unmatched response
-    network::UUID _tid;
+    // Outstanding requests, discard unmatched response
+    TransactionTable _transactions;
+    
+    // Definitive error code of last binding, 0 if none
+    int _error;
 };
 
 STUN_END
@@ -0,0 +1,297 @@
+//
+//  EventLoop.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "EventLoop.h"
+#include <cassert>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+#if defined(__linux)
+#   include <sys/epoll.h>
+#   include <sys/timerfd.h>
+#endif
+
+NETWORK_BEGIN
+
+// Events taken by one wait
+#define MAX_LOOP_EVENTS 256
+
+EventLoop::EventLoop()
+: _nextTimer(1)
+{
+#if defined(__linux)
+    _epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    _timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    _armed = 0;
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = _timerfd;
+    if(_epoll < 0 || _timerfd < 0 || ::epoll_ctl(_epoll, EPOLL_CTL_ADD, _timerfd, &ev) < 0)
+    {
+        std::cerr << "EventLoop::EventLoop() failed!\n";
+        close();
+    }
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+#if defined(__linux)
+    close();
+#endif
+}
+
+#if defined(__linux)
+
+void EventLoop::close()
+{
+    if(_timerfd >= 0)
+    {
+        ::close(_timerfd);
+        _timerfd = -1;
+    }
+    if(_epoll >= 0)
+    {
+        ::close(_epoll);
+        _epoll = -1;
+    }
+}
+
+#endif
+
+// Monotonic clock, ms
+int64_t EventLoop::now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool EventLoop::add(SOCKET fd, const Handler& handler)
+{
+    assert(fd != INVALID_SOCKET);
+    if(!valid())
+    {
+        return false;
+    }
+    
+#if defined(__linux)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    int op = _handlers.count(fd) > 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if(::epoll_ctl(_epoll, op, fd, &ev) < 0)
+    {
+        return false;
+    }
+#endif
+    _handlers[fd] = handler;
+    return true;
+}
+
+void EventLoop::remove(SOCKET fd)
+{
+    if(_handlers.erase(fd) > 0)
+    {
+#if defined(__linux)
+        struct epoll_event ev; // Not NULL for old kernels
+        ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &ev);
+#endif
+    }
+}
+
+unsigned long EventLoop::setTimer(int timeout, const TimerHandler& handler)
+{
+    unsigned long id = _nextTimer++;
+    int64_t deadline = now() + timeout;
+    _timers[TimerKey(deadline, id)] = handler;
+    _deadlines[id] = deadline;
+#if defined(__linux)
+    arm();
+#endif
+    return id;
+}
+
+void EventLoop::cancelTimer(unsigned long id)
+{
+    std::unordered_map<unsigned long, int64_t>::iterator it = _deadlines.find(id);
+    if(it != _deadlines.end())
+    {
+        _timers.erase(TimerKey(it->second, id));
+        _deadlines.erase(it);
+    }
+}
+
+// Call handlers of due timers, returns number called
+int EventLoop::expire()
+{
+    int count = 0;
+    int64_t time = now();
+    while(!_timers.empty() && _timers.begin()->first.first <= time)
+    {
+        // A handler may set or cancel timers, so take it out first
+        TimerHandler handler;
+        handler.swap(_timers.begin()->second);
+        _deadlines.erase(_timers.begin()->first.second);
+        _timers.erase(_timers.begin());
+        handler();
+        ++count;
+    }
+    return count;
+}
+
+#if defined(__linux)
+
+// Set timerfd to the first deadline
+void EventLoop::arm()
+{
+    int64_t deadline = _timers.empty() ? 0 : _timers.begin()->first.first;
+    if(deadline == _armed || !valid())
+    {
+        return;
+    }
+    
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if(deadline != 0)
+    {
+        // Relative, a zero value would disarm
+        int64_t wait = deadline - now();
+        if(wait <= 0)
+        {
+            its.it_value.tv_nsec = 1;
+        }
+        else
+        {
+            its.it_value.tv_sec = wait / 1000;
+            its.it_value.tv_nsec = (wait % 1000) * 1000000;
+        }
+    }
+    ::timerfd_settime(_timerfd, 0, &its, NULL);
+    _armed = deadline;
+}
+
+int EventLoop::run(int timeout)
+{
+    if(!valid())
+    {
+        return -1;
+    }
+    
+    struct epoll_event events[MAX_LOOP_EVENTS];
+    int n = ::epoll_wait(_epoll, events, MAX_LOOP_EVENTS, timeout);
+    if(n < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+    
+    int count = 0;
+    for(int i = 0; i < n; ++i)
+    {
+        int fd = events[i].data.fd;
+        if(fd == _timerfd)
+        {
+            uint64_t expirations;
+            ssize_t rc = ::read(_timerfd, &expirations, sizeof(expirations));
+            (void)rc;
+            _armed = 0;
+            count += expire();
+            continue;
+        }
+        
+        // A handler may remove sockets, including its own
+        std::unordered_map<SOCKET, Handler>::iterator it = _handlers.find(fd);
+        if(it != _handlers.end())
+        {
+            Handler handler = it->second;
+            handler(fd);
+            ++count;
+        }
+    }
+    arm();
+    return count;
+}
+
+#else
+
+int EventLoop::run(int timeout)
+{
+    // Wake up for the first timer
+    if(!_timers.empty())
+    {
+        int64_t wait = _timers.begin()->first.first - now();
+        wait = wait < 0 ? 0 : wait;
+        if(timeout < 0 || wait < timeout)
+        {
+            timeout = static_cast<int>(wait);
+        }
+    }
+    
+    std::vector<struct pollfd> fds;
+    fds.reserve(_handlers.size());
+    for(std::unordered_map<SOCKET, Handler>::iterator it = _handlers.begin(); it != _handlers.end(); ++it)
+    {
+        struct pollfd pfd;
+        pfd.fd = it->first;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        fds.push_back(pfd);
+    }
+    
+#if defined(_WIN32)
+    // WSAPoll fails with no socket
+    int n = 0;
+    if(fds.empty())
+    {
+        ::Sleep(timeout < 0 ? INFINITE : timeout);
+    }
+    else
+    {
+        n = ::WSAPoll(&fds[0], static_cast<ULONG>(fds.size()), timeout);
+    }
+#else
+    int n = ::poll(fds.empty() ? NULL : &fds[0], fds.size(), timeout);
+#endif
+    if(n < 0)
+    {
+#if !defined(_WIN32)
+        if(errno == EINTR)
+        {
+            return 0;
+        }
+#endif
+        return -1;
+    }
+    
+    int count = 0;
+    for(size_t i = 0; i < fds.size() && n > 0; ++i)
+    {
+        if(fds[i].revents == 0)
+        {
+            continue;
+        }
+        --n;
+        
+        std::unordered_map<SOCKET, Handler>::iterator it = _handlers.find(fds[i].fd);
+        if(it != _handlers.end())
+        {
+            Handler handler = it->second;
+            handler(fds[i].fd);
+            ++count;
+        }
+    }
+    count += expire();
+    return count;
+}
+
+#endif
+
+NETWORK_END
@@ -0,0 +1,102 @@
+//
+//  EventLoop.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_EVENT_LOOP_H
+#define NETWORK_EVENT_LOOP_H
+
+#include "Network.h"
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+NETWORK_BEGIN
+
+//
+// Readiness of many sockets and timers, dispatched from one thread
+// Sockets are watched with epoll and timers are driven by a timerfd on
+// Linux, so a wait costs the same with one socket or thousands
+// Other systems fall back to poll(), which has no FD_SETSIZE limit
+// Not thread safe, handlers run on the thread calling run()
+//
+// network::EventLoop loop;
+// loop.add(socket.fd(), [&](SOCKET fd) { socket.read(&batch); ... });
+// unsigned long timer = loop.setTimer(200, [&]() { socket.write(...); });
+// while(pending) loop.run(-1);
+//
+
+class EventLoop
+{
+public:
+    typedef std::function<void(SOCKET)> Handler;
+    typedef std::function<void()> TimerHandler;
+    
+    EventLoop();
+    ~EventLoop();
+    
+    // False if epoll or timerfd could not be set up, then add() and
+    // run() fail
+    bool valid() const
+    {
+#if defined(__linux)
+        return _epoll >= 0;
+#else
+        return true;
+#endif
+    }
+    
+    // Call handler when fd is readable, until removed
+    bool add(SOCKET fd, const Handler& handler);
+    void remove(SOCKET fd);
+    
+    // Call handler once after timeout (ms), returns timer id
+    unsigned long setTimer(int timeout, const TimerHandler& handler);
+    void cancelTimer(unsigned long id);
+    
+    // Wait up to timeout (ms, -1 for ever) and dispatch ready events
+    // Returns number of handlers called, -1 if failed
+    int run(int timeout);
+    
+    // Number of watched sockets and pending timers
+    size_t sockets() const
+    {
+        return _handlers.size();
+    }
+    
+    size_t timers() const
+    {
+        return _timers.size();
+    }
+    
+private:
+    std::unordered_map<SOCKET, Handler> _handlers;
+    
+    // Timers ordered by deadline (ms), then id
+    typedef std::pair<int64_t, unsigned long> TimerKey;
+    std::map<TimerKey, TimerHandler> _timers;
+    std::unordered_map<unsigned long, int64_t> _deadlines; // Of timer id
+    unsigned long _nextTimer;
+    
+#if defined(__linux)
+    int _epoll;
+    int _timerfd;
+    int64_t _armed; // Deadline timerfd is set to, 0 if none
+    
+    void arm();
+    void close();
+#endif
+    
+    static int64_t now();
+    int expire();
+    
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+};
+
+NETWORK_END
+
+#endif
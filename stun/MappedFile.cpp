@@ -0,0 +1,150 @@
+//
+//  MappedFile.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "MappedFile.h"
+
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+NETWORK_BEGIN
+
+MappedFile::MappedFile()
+: _data(NULL)
+, _size(0)
+#if defined(_WIN32)
+, _file(INVALID_HANDLE_VALUE)
+, _mapping(NULL)
+#endif
+{
+    
+}
+
+MappedFile::MappedFile(const std::string& path)
+: _data(NULL)
+, _size(0)
+#if defined(_WIN32)
+, _file(INVALID_HANDLE_VALUE)
+, _mapping(NULL)
+#endif
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    
+    _file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    
+    LARGE_INTEGER size;
+    if(!::GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    
+    _mapping = ::CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(_mapping == NULL)
+    {
+        close();
+        return false;
+    }
+    
+    _data = static_cast<const unsigned char*>(::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(_data == NULL)
+    {
+        close();
+        return false;
+    }
+    
+    _size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(_data != NULL)
+    {
+        ::UnmapViewOfFile(_data);
+    }
+    if(_mapping != NULL)
+    {
+        ::CloseHandle(_mapping);
+    }
+    if(_file != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(_file);
+    }
+    
+    _data = NULL;
+    _size = 0;
+    _mapping = NULL;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+// Empty file can't be mapped, fails to open
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    
+    size_t size = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // Mapping keeps the file
+    if(p == MAP_FAILED)
+    {
+        return false;
+    }
+    
+    ::madvise(p, size, MADV_SEQUENTIAL);
+    _data = static_cast<const unsigned char*>(p);
+    _size = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(_data != NULL)
+    {
+        ::munmap(const_cast<unsigned char*>(_data), _size);
+    }
+    
+    _data = NULL;
+    _size = 0;
+}
+
+#endif
+
+NETWORK_END
@@ -0,0 +1,69 @@
+//
+//  MappedFile.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_MAPPED_FILE_H
+#define NETWORK_MAPPED_FILE_H
+
+#include "BufferView.h"
+#include <string>
+
+NETWORK_BEGIN
+
+//
+// Read-only memory mapping of a whole file
+// Pages are read ahead as the file is scanned from begin to end
+//
+// network::MappedFile file("capture.pcap");
+// network::BufferView view = file.view();
+//
+
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const
+    {
+        return _data != NULL;
+    }
+
+    const unsigned char* data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    // View of the whole file
+    BufferView view() const
+    {
+        return BufferView(_data, _size);
+    }
+
+private:
+    const unsigned char* _data;
+    size_t _size;
+#if defined(_WIN32)
+    HANDLE _file;
+    HANDLE _mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+NETWORK_END
+
+#endif
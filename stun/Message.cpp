@@ -7,7 +7,9 @@
 //
 
 #include "Message.h"
-#include <iostream>
+#include <stun/BufferReader.h>
+#include <stun/Crc32.h>
+#include <stun/Random.h>
 
 STUN_BEGIN
 
@@ -35,41 +37,84 @@ size_t Attribute::length() const
 
 unsigned short Attribute::checkType(network::Buffer* buf)
 {
-    return ntohs(buf->peek16u());
+    return buf->peekBE16();
+}
+
+unsigned short Attribute::checkType(network::BufferView* buf)
+{
+    return buf->peekBE16();
 }
 
 size_t Attribute::toBuffer(network::Buffer* buf) const
 {
-    // Type + Length
-    size_t len = buf->write16u(htons(_type));
-    len += buf->write16u(htons(length()));
+    size_t n = ATTRIBUTE_HEADER_LENGTH + ATTRIBUTE_PADDED_LENGTH(length());
+    if(buf->reserve(n) < n)
+    {
+        return 0;
+    }
     
-    // Value
-    len += valueToBuffer(buf);
-    return len;
+    network::BufferWriter w(buf->write(), n);
+    toBuffer(&w);
+    buf->write(w.written());
+    return w.written();
+}
+
+void Attribute::toBuffer(network::BufferWriter* w) const
+{
+    if(w->require(ATTRIBUTE_HEADER_LENGTH + ATTRIBUTE_PADDED_LENGTH(length())))
+    {
+        // Type + Length
+        w->putBE16(_type);
+        w->putBE16(length());
+        
+        // Value + Padding
+        valueToBuffer(w);
+        w->fill(0, ATTRIBUTE_PADDED_LENGTH(length()) - length());
+    }
 }
 
+// Parse through a view of readable bytes, then remove parsed bytes
 bool Attribute::fromBuffer(network::Buffer* buf)
 {
-    // Type + Value
-    unsigned short type = ntohs(buf->read16u());
+    network::BufferView view(*buf);
+    bool rs = fromBuffer(&view);
+    buf->read(buf->readable() - view.readable());
+    return rs;
+}
+
+// Nothing is read if the attribute is truncated
+bool Attribute::fromBuffer(network::BufferView* buf)
+{
+    network::BufferReader r(*buf);
+    if(!r.require(ATTRIBUTE_HEADER_LENGTH))
+    {
+        return false;
+    }
+    
+    // Type + Length
+    unsigned short type = r.getBE16();
     assert(type == _type);
+    _length = r.getBE16();
     
-    _length = ntohs(buf->read16u());
-    assert(buf->readable() >= _length);
-
-    return valueFromBuffer(buf);
+    // Value is parsed within its own length
+    network::BufferView value = r.view(_length);
+    r.skip(ATTRIBUTE_PADDED_LENGTH(_length) - _length);
+    if(r.failed() || type != _type)
+    {
+        return false;
+    }
+    
+    buf->read(r.consumed());
+    return valueFromBuffer(&value);
 }
 
-size_t Attribute::valueToBuffer(network::Buffer* buf) const
+void Attribute::valueToBuffer(network::BufferWriter* w) const
 {
-    // Write ambigious data with '_length' size
-    buf->reserve(_length);
-    buf->write(_length);
-    return _length;
+    // Value is not kept, write zeros of '_length' size
+    w->fill(0, _length);
 }
 
-bool Attribute::valueFromBuffer(network::Buffer* buf)
+bool Attribute::valueFromBuffer(network::BufferView* buf)
 {
     // Read data of '_length' size
     if(buf->readable() >= _length)
@@ -84,6 +129,8 @@ bool Attribute::valueFromBuffer(network::Buffer* buf)
 
 Message::Message(MESSAGE_TYPE type)
 : _type(type)
+, _fingerprint(false)
+, _credential(NULL)
 {
 
 }
@@ -91,15 +138,17 @@ Message::Message(MESSAGE_TYPE type)
 Message::Message(MESSAGE_TYPE type, const network::UUID& tid)
 : _type(type)
 , _tid(tid)
+, _fingerprint(false)
+, _credential(NULL)
 {
 
 }
 
 Message::~Message()
 {
-    for(int i = 0; i < _attributes.size(); ++i)
+    for(size_t i = 0; i < _attributes.size(); ++i)
     {
-        delete _attributes[i];
+        delete _attributes[i].attribute;
     }
     _attributes.clear();
 }
@@ -112,10 +161,25 @@ MESSAGE_TYPE Message::type() const
 size_t Message::length() const
 {
     size_t len = 0; //MESSAGE_HEADER_LENGTH;
-    for(int i = 0; i < _attributes.size(); ++i)
+    for(size_t i = 0; i < _attributes.size(); ++i)
     {
-        len += ATTRIBUTE_HEADER_LENGTH;
-        len += _attributes[i]->length();
+        if(_attributes[i].attribute != NULL)
+        {
+            len += ATTRIBUTE_HEADER_LENGTH;
+            len += ATTRIBUTE_PADDED_LENGTH(_attributes[i].attribute->length());
+        }
+        else
+        {
+            len += _attributes[i].length;
+        }
+    }
+    if(_credential != NULL)
+    {
+        len += ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH;
+    }
+    if(_fingerprint)
+    {
+        len += ATTRIBUTE_HEADER_LENGTH + 4;
     }
     return len;
 }
@@ -125,6 +189,156 @@ network::UUID Message::tid() const
     return _tid;
 }
 
+bool Message::hasMagicCookie() const
+{
+    return network::loadBE32(_tid.bytes()) == MAGIC_COOKIE;
+}
+
+network::UUID Message::newTid(bool cookie)
+{
+    unsigned char b[16];
+    if(cookie)
+    {
+        network::storeBE32(b, MAGIC_COOKIE);
+        network::Random::local().bytes(b + 4, 12);
+    }
+    else
+    {
+        network::Random::local().bytes(b, 16);
+    }
+    return network::UUID(b, sizeof(b));
+}
+
+size_t Message::size() const
+{
+    return MESSAGE_HEADER_LENGTH + length();
+}
+
+/*
+ RFC 5389
+ 15.5.  FINGERPRINT
+ The value of the attribute is computed as the CRC-32 of the STUN message
+ up to (but excluding) the FINGERPRINT attribute itself, XOR'ed with
+ the 32-bit value 0x5354554e.  When present, the FINGERPRINT attribute
+ MUST be the last attribute in the message, and thus will appear after
+ MESSAGE-INTEGRITY.
+ */
+
+#define FINGERPRINT_XOR 0x5354554e
+
+/*
+ RFC 5389
+ 15.4.  MESSAGE-INTEGRITY
+ The text used as input to HMAC is the STUN message, including the
+ header, up to and including the attribute preceding the MESSAGE-
+ INTEGRITY attribute.  With the exception of the FINGERPRINT
+ attribute, which appears after MESSAGE-INTEGRITY, agents MUST ignore
+ all other attributes that follow MESSAGE-INTEGRITY.
+ 
+ The length field of the STUN message header is adjusted to point to
+ the end of the MESSAGE-INTEGRITY attribute when computing the HMAC.
+ 
+ RFC 3489 instead pads the text with zeroes to a multiple of 64 bytes,
+ and leaves the length field as it is. Messages without the magic
+ cookie are taken as RFC 3489.
+ */
+
+// HMAC of the message at b, n is the memory length up to the end of
+// MESSAGE-INTEGRITY, the attribute itself is not read
+static void computeIntegrity(const Credential& credential, const unsigned char* b, size_t n, unsigned char* mac)
+{
+    assert(n >= MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH);
+    size_t text = n - (ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH);
+    
+    network::Sha1 sha = credential.hmac().begin();
+    if(network::loadBE32(b + 4) == MAGIC_COOKIE)
+    {
+        unsigned char header[MESSAGE_HEADER_LENGTH];
+        memcpy(header, b, MESSAGE_HEADER_LENGTH);
+        network::storeBE16(header + 2, static_cast<uint16_t>(n - MESSAGE_HEADER_LENGTH));
+        sha.update(header, MESSAGE_HEADER_LENGTH);
+        sha.update(b + MESSAGE_HEADER_LENGTH, text - MESSAGE_HEADER_LENGTH);
+    }
+    else
+    {
+        static const unsigned char zeros[DIGEST_BLOCK_LENGTH] = { 0 };
+        sha.update(b, text);
+        sha.update(zeros, (DIGEST_BLOCK_LENGTH - text % DIGEST_BLOCK_LENGTH) % DIGEST_BLOCK_LENGTH);
+    }
+    credential.hmac().end(sha, mac);
+}
+
+void Message::setCredential(const Credential* credential)
+{
+    _credential = credential;
+}
+
+bool Message::checkIntegrity(const Credential& credential) const
+{
+    return !_integrity.empty() && checkIntegrity(&_integrity[0], _integrity.size(), credential);
+}
+
+bool Message::checkIntegrity(const unsigned char* b, size_t n, const Credential& credential)
+{
+    if(n < MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH)
+    {
+        return false;
+    }
+    
+    const unsigned char* p = b + n - (ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH);
+    if(network::loadBE16(p) != AT_MESSAGE_INTEGRITY || network::loadBE16(p + 2) != MESSAGE_INTEGRITY_LENGTH)
+    {
+        return false;
+    }
+    
+    // Compare all bytes, in constant time
+    unsigned char mac[MESSAGE_INTEGRITY_LENGTH];
+    computeIntegrity(credential, b, n, mac);
+    unsigned char diff = 0;
+    for(size_t i = 0; i < MESSAGE_INTEGRITY_LENGTH; ++i)
+    {
+        diff |= mac[i] ^ p[ATTRIBUTE_HEADER_LENGTH + i];
+    }
+    return diff == 0;
+}
+
+// Keep received bytes up to the end of MESSAGE-INTEGRITY to check later
+bool Message::keepIntegrity(const unsigned char* message, size_t n)
+{
+    if(n < MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH
+       || network::loadBE16(message + n - MESSAGE_INTEGRITY_LENGTH - 2) != MESSAGE_INTEGRITY_LENGTH)
+    {
+        return false;
+    }
+    _integrity.assign(message, message + n);
+    return true;
+}
+
+void Message::setFingerprint(bool fingerprint)
+{
+    _fingerprint = fingerprint;
+}
+
+bool Message::hasFingerprint() const
+{
+    return _fingerprint;
+}
+
+bool Message::checkFingerprint(const unsigned char* b, size_t n)
+{
+    if(n < MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + 4)
+    {
+        return false;
+    }
+    
+    const unsigned char* p = b + n - (ATTRIBUTE_HEADER_LENGTH + 4);
+    if(network::loadBE16(p) != AT_FINGERPRINT || network::loadBE16(p + 2) != 4)
+    {
+        return false;
+    }
+    return network::loadBE32(p + 4) == (network::crc32(b, p - b) ^ FINGERPRINT_XOR);
+}
+
 std::string Message::toString() const
 {
     return _tid.toString();
@@ -132,117 +346,391 @@ std::string Message::toString() const
 
 void Message::setAttribute(Attribute* attribute)
 {
-    _attributes.push_back(attribute);
+    AttributeEntry entry = { attribute, static_cast<unsigned short>(attribute->type()), 0, 0 };
+    _attributes.push_back(entry);
 }
 
+// First attribute of type, decoded on first access
 Attribute* Message::findAttribute(ATTRIBUTE_TYPE type) const
 {
-    for(int i = 0; i < _attributes.size(); ++i)
+    size_t i = 0;
+    while(i < _attributes.size())
     {
-        if(_attributes[i]->type() == type)
+        if(_attributes[i].type != type)
+        {
+            ++i;
+            continue;
+        }
+        
+        if(_attributes[i].attribute != NULL)
+        {
+            return _attributes[i].attribute;
+        }
+        
+        // Malformed entry is removed, and i is the next one
+        Attribute* attribute = decodeAttribute(i);
+        if(attribute != NULL)
         {
-            return _attributes[i];
+            return attribute;
         }
     }
     return NULL;
 }
 
+// Malformed value is dropped, as if the attribute is not present
+Attribute* Message::decodeAttribute(size_t i) const
+{
+    assert(i < _attributes.size() && _attributes[i].attribute == NULL);
+    network::BufferView view(&_raw[_attributes[i].offset], _attributes[i].length);
+    Attribute* attribute = AttributeFactory::fromBuffer(&view);
+    if(attribute == NULL)
+    {
+        _attributes.erase(_attributes.begin() + i);
+        return NULL;
+    }
+    
+    _attributes[i].attribute = attribute;
+    return attribute;
+}
+
 unsigned short Message::checkType(network::Buffer* buf)
 {
-    return ntohs(buf->peek16u());
+    return buf->peekBE16();
+}
+
+unsigned short Message::checkType(network::BufferView* buf)
+{
+    return buf->peekBE16();
 }
 
+// Top 2 bits of type zero, length a multiple of 4 that covers the
+// rest of datagram, and a known method
+MESSAGE_VERSION Message::classify(const unsigned char* b, size_t n)
+{
+    if(n < MESSAGE_HEADER_LENGTH)
+    {
+        return MV_NONE;
+    }
+    
+    uint32_t word = network::loadBE32(b);
+    uint32_t method = (word >> 16) & MESSAGE_METHOD_BITS;
+    if((word & 0xC0000003) != 0
+       || (word & 0xFFFF) + MESSAGE_HEADER_LENGTH != n
+       || (method != METHOD_BINDING && method != METHOD_SHARED_SECRET))
+    {
+        return MV_NONE;
+    }
+    return network::loadBE32(b + 4) == MAGIC_COOKIE ? MV_RFC5389 : MV_RFC3489;
+}
+
+// Nothing is written if the buffer can not hold the message
 size_t Message::toBuffer(network::Buffer* buf) const
 {
-    size_t len = 0;
+    size_t length = this->length();
+    size_t n = MESSAGE_HEADER_LENGTH + length;
+    if(buf->reserve(n) < n)
+    {
+        return 0;
+    }
     
-    // Header
-    len += buf->write16u(htons(_type));
-    len += buf->write16u(htons(length()));
-    len += buf->writeBlob(_tid.bytes(), _tid.size());
+    network::BufferWriter w(buf->write(), n);
+    pack(&w, length);
+    assert(w.good() && w.written() == n);
+    buf->write(w.written());
+    return w.written();
+}
+
+size_t Message::toBuffer(unsigned char* b, size_t n) const
+{
+    size_t length = this->length();
+    if(n < MESSAGE_HEADER_LENGTH + length)
+    {
+        return 0;
+    }
     
-    // Attributes
-    for(int i = 0; i < _attributes.size(); ++i)
+    network::BufferWriter w(b, n);
+    pack(&w, length);
+    assert(w.good());
+    return w.written();
+}
+
+void Message::toBuffer(network::BufferWriter* w) const
+{
+    pack(w, length());
+}
+
+void Message::pack(network::BufferWriter* w, size_t length) const
+{
+    unsigned char* begin = w->write();
+    headerToBuffer(w, length);
+    attributesToBuffer(w);
+    if(_credential != NULL && w->require(ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH))
     {
-        len += _attributes[i]->toBuffer(buf);
+        w->putBE16(AT_MESSAGE_INTEGRITY);
+        w->putBE16(MESSAGE_INTEGRITY_LENGTH);
+        unsigned char mac[MESSAGE_INTEGRITY_LENGTH];
+        computeIntegrity(*_credential, begin, w->write() - begin + MESSAGE_INTEGRITY_LENGTH, mac);
+        w->put(mac, MESSAGE_INTEGRITY_LENGTH);
+    }
+    if(_fingerprint && w->require(ATTRIBUTE_HEADER_LENGTH + 4))
+    {
+        uint32_t crc = network::crc32(begin, w->write() - begin);
+        w->putBE16(AT_FINGERPRINT);
+        w->putBE16(4);
+        w->putBE32(crc ^ FINGERPRINT_XOR);
+    }
+}
+
+size_t Message::headerToBuffer(network::Buffer* buf, size_t length) const
+{
+    if(buf->reserve(MESSAGE_HEADER_LENGTH) < MESSAGE_HEADER_LENGTH)
+    {
+        return 0;
     }
     
-    return len;
+    network::BufferWriter w(buf->write(), MESSAGE_HEADER_LENGTH);
+    headerToBuffer(&w, length);
+    buf->write(w.written());
+    return w.written();
 }
 
-bool Message::fromBuffer(network::Buffer* buf)
+size_t Message::attributesToBuffer(network::Buffer* buf) const
 {
-    assert(buf->readable() >= MESSAGE_HEADER_LENGTH);
-    if(buf->readable() < MESSAGE_HEADER_LENGTH)
+    size_t n = length();
+    if(buf->reserve(n) < n)
+    {
+        return 0;
+    }
+    
+    network::BufferWriter w(buf->write(), n);
+    attributesToBuffer(&w);
+    buf->write(w.written());
+    return w.written();
+}
+
+void Message::headerToBuffer(network::BufferWriter* w, size_t length) const
+{
+    if(w->require(MESSAGE_HEADER_LENGTH))
+    {
+        w->putBE16(_type);
+        w->putBE16(length);
+        w->put(_tid.bytes(), 16);
+    }
+}
+
+// In the order they were received or set
+// Attributes not decoded are packed as they were received
+void Message::attributesToBuffer(network::BufferWriter* w) const
+{
+    for(size_t i = 0; i < _attributes.size(); ++i)
+    {
+        const AttributeEntry& entry = _attributes[i];
+        if(entry.attribute != NULL)
+        {
+            entry.attribute->toBuffer(w);
+        }
+        else
+        {
+            w->writeBlob(&_raw[entry.offset], entry.length);
+        }
+    }
+}
+
+// Parse through a view of readable bytes, then remove parsed bytes
+bool Message::fromBuffer(network::Buffer* buf, bool lazy)
+{
+    network::BufferView view(*buf);
+    bool rs = fromBuffer(&view, lazy);
+    buf->read(buf->readable() - view.readable());
+    return rs;
+}
+
+// Nothing is read if the message is truncated
+bool Message::fromBuffer(network::BufferView* buf, bool lazy)
+{
+    const unsigned char* message = buf->read();
+    network::BufferReader r(*buf);
+    if(!r.require(MESSAGE_HEADER_LENGTH))
     {
         return false;
     }
     
-    unsigned short type = ntohs(buf->read16u());
+    // Header
+    unsigned short type = r.getBE16();
     assert(type == _type);
+    size_t length = r.getBE16(); // Memory length of attributes
+    _tid = network::UUID(r.get(16), 16);
     
-    size_t length = ntohs(buf->read16u()); // Memory length of attributes
-    _tid = network::UUID(buf->read(), buf->readable());
-    assert(_tid.size() == 16);
-    buf->read(16);
-    
-    assert(buf->readable() >= length);
-    if(buf->readable() < length)
+    // Attributes
+    network::BufferView attributes = r.view(length);
+    if(r.failed() || type != _type)
     {
         return false;
     }
     
-    while(length > 0)
+    buf->read(r.consumed());
+    if(lazy)
     {
-        Attribute* attribute = AttributeFactory::fromBuffer(buf);
-        if(attribute != NULL)
+        return indexAttributes(message, attributes);
+    }
+    
+    bool integrity = false;
+    while(attributes.readable() > 0)
+    {
+        // FINGERPRINT is the last attribute, and is checked, not kept
+        if(attributes.readable() >= ATTRIBUTE_HEADER_LENGTH && Attribute::checkType(&attributes) == AT_FINGERPRINT)
         {
-            _attributes.push_back(attribute);
-            length -= ATTRIBUTE_HEADER_LENGTH + attribute->length();
+            _fingerprint = checkFingerprint(message, MESSAGE_HEADER_LENGTH + length);
+            return _fingerprint && attributes.readable() == ATTRIBUTE_HEADER_LENGTH + 4;
         }
-        else
+        
+        // Other attributes after MESSAGE-INTEGRITY are ignored (RFC 5389 15.4)
+        if(integrity)
+        {
+            if(attributes.readable() < ATTRIBUTE_HEADER_LENGTH)
+            {
+                return false;
+            }
+            size_t skip = ATTRIBUTE_HEADER_LENGTH + ATTRIBUTE_PADDED_LENGTH(attributes.peekBE16(2));
+            if(attributes.readable() < skip)
+            {
+                return false;
+            }
+            attributes.read(skip);
+            continue;
+        }
+        
+        // MESSAGE-INTEGRITY is checked later with a credential, not kept
+        if(attributes.readable() >= ATTRIBUTE_HEADER_LENGTH && Attribute::checkType(&attributes) == AT_MESSAGE_INTEGRITY)
+        {
+            size_t end = MESSAGE_HEADER_LENGTH + length - attributes.readable() + ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH;
+            if(attributes.readable() < ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH || !keepIntegrity(message, end))
+            {
+                return false;
+            }
+            attributes.read(ATTRIBUTE_HEADER_LENGTH + MESSAGE_INTEGRITY_LENGTH);
+            integrity = true;
+            continue;
+        }
+        
+        Attribute* attribute = AttributeFactory::fromBuffer(&attributes);
+        if(attribute == NULL)
+        {
+            return false;
+        }
+        setAttribute(attribute);
+    }
+    return true;
+}
+
+// Check the TLV framing of attributes and keep a copy of them,
+// values are not parsed here
+bool Message::indexAttributes(const unsigned char* message, const network::BufferView& attributes)
+{
+    network::BufferReader r(attributes);
+    bool integrity = false;
+    while(r.readable() > 0)
+    {
+        if(!r.require(ATTRIBUTE_HEADER_LENGTH))
         {
+            return false;
+        }
+        
+        AttributeEntry entry;
+        entry.attribute = NULL;
+        entry.offset = static_cast<unsigned short>(r.consumed());
+        entry.type = r.getBE16();
+        size_t length = ATTRIBUTE_PADDED_LENGTH(r.getBE16());
+        if(!r.skip(length))
+        {
+            return false;
+        }
+        
+        // FINGERPRINT is the last attribute, and is checked, not kept
+        if(entry.type == AT_FINGERPRINT)
+        {
+            _fingerprint = checkFingerprint(message, MESSAGE_HEADER_LENGTH + r.consumed());
+            if(!_fingerprint || r.readable() > 0)
+            {
+                return false;
+            }
             break;
         }
+        
+        // Other attributes after MESSAGE-INTEGRITY are ignored (RFC 5389 15.4)
+        if(integrity)
+        {
+            continue;
+        }
+        
+        // MESSAGE-INTEGRITY is checked later with a credential, not kept
+        if(entry.type == AT_MESSAGE_INTEGRITY)
+        {
+            if(!keepIntegrity(message, MESSAGE_HEADER_LENGTH + r.consumed()))
+            {
+                return false;
+            }
+            integrity = true;
+            continue;
+        }
+        
+        entry.length = static_cast<unsigned short>(ATTRIBUTE_HEADER_LENGTH + length);
+        _attributes.push_back(entry);
     }
-    assert(length == 0);
+    
+    _raw.assign(attributes.read(), attributes.read() + attributes.readable());
     return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
-Message* MessageFactory::fromBuffer(network::Buffer* buf)
+Message* MessageFactory::fromBuffer(network::Buffer* buf, bool lazy)
 {
     assert(buf != NULL);
+    network::BufferView view(*buf);
+    Message* msg = fromBuffer(&view, lazy);
+    buf->read(buf->readable() - view.readable());
+    return msg;
+}
+
+// NULL if the message is truncated or malformed
+Message* MessageFactory::fromBuffer(network::BufferView* buf, bool lazy)
+{
+    assert(buf != NULL);
+    if(buf->readable() < MESSAGE_HEADER_LENGTH)
+    {
+        return NULL;
+    }
+    
+    Message* msg = NULL;
     unsigned short type = Message::checkType(buf);
     switch (type)
     {
         case MT_BINDING_RESPONSE:
-        {
-            BindingResponse* msg = new BindingResponse();
-            msg->fromBuffer(buf);
-            return msg;
-        }
-        break;
+            msg = new BindingResponse();
+            break;
+            
         case MT_BINDING_ERROR_RESPONSE:
-        {
-            BindingErrorResponse* msg = new BindingErrorResponse();
-            msg->fromBuffer(buf);
-            return msg;
-        }
-        break;
+            msg = new BindingErrorResponse();
+            break;
             
         default:
-            assert(false);
-            break;
+            // Not a message of client, or not STUN at all
+            return NULL;
     }
-    return NULL;
+    
+    if(!msg->fromBuffer(buf, lazy))
+    {
+        delete msg;
+        return NULL;
+    }
+    return msg;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 
 BindingRequest::BindingRequest()
-: Message(MT_BINDING_REQUEST, network::UUID::New())
+: Message(MT_BINDING_REQUEST, newTid())
 {
     
 }
@@ -266,12 +754,30 @@ void BindingRequest::setChangeRequest(bool port, bool ip)
 
 void BindingRequest::setUserName(const std::string &name)
 {
+    setAttribute(new StringAttribute(AT_USER_NAME, name));
+}
+
+void BindingRequest::setRealm(const std::string& realm)
+{
+    setAttribute(new StringAttribute(AT_REALM, realm));
+}
 
+void BindingRequest::setNonce(const std::string& nonce)
+{
+    setAttribute(new StringAttribute(AT_NONCE, nonce));
 }
 
-void BindingRequest::setMessageIntegrity()
+void BindingRequest::setMessageIntegrity(const Credential& credential)
 {
-    // Calculate HMAC and set MessageIntegrityAttribute
+    if(findAttribute(AT_USER_NAME) == NULL)
+    {
+        setUserName(credential.username());
+    }
+    if(credential.isLongTerm() && findAttribute(AT_REALM) == NULL)
+    {
+        setRealm(credential.realm());
+    }
+    setCredential(&credential);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -287,8 +793,16 @@ BindingResponse::~BindingResponse()
 }
 
 // Attributes
+// RFC 5389 servers may only send XOR-MAPPED-ADDRESS, and it is not
+// rewritten by NATs that touch addresses in payloads
 sockaddr_in BindingResponse::mappedAddress() const
 {
+    sockaddr_storage ss;
+    if(xorMappedAddress(&ss) && ss.ss_family == AF_INET)
+    {
+        return *reinterpret_cast<sockaddr_in*>(&ss);
+    }
+    
     AddressAttribute* aa = dynamic_cast<AddressAttribute*>(findAttribute(AT_MAPPED_ADDRESS));
     if(aa != NULL)
     {
@@ -327,9 +841,15 @@ sockaddr_in BindingResponse::reflectedFrom() const
     return sockaddr_in();
 }
 
-bool BindingResponse::messageIntegrity() const
+bool BindingResponse::xorMappedAddress(sockaddr_storage* sa) const
 {
-    return true;
+    XorAddressAttribute* xa = dynamic_cast<XorAddressAttribute*>(findAttribute(AT_XOR_MAPPED_ADDRESS));
+    return xa != NULL && xa->address(_tid, sa);
+}
+
+bool BindingResponse::messageIntegrity(const Credential& credential) const
+{
+    return checkIntegrity(credential);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -355,6 +875,58 @@ BindingErrorResponse::~BindingErrorResponse()
     
 }
 
+int BindingErrorResponse::errorClass() const
+{
+    return errorCode() / 100;
+}
+
+int BindingErrorResponse::errorNumber() const
+{
+    return errorCode() % 100;
+}
+
+int BindingErrorResponse::errorCode() const
+{
+    ErrorCodeAttribute* ea = dynamic_cast<ErrorCodeAttribute*>(findAttribute(AT_ERROR_CODE));
+    if(ea != NULL)
+    {
+        return ea->errorCode();
+    }
+    return 0;
+}
+
+std::string BindingErrorResponse::errorReason() const
+{
+    ErrorCodeAttribute* ea = dynamic_cast<ErrorCodeAttribute*>(findAttribute(AT_ERROR_CODE));
+    if(ea != NULL)
+    {
+        return ea->reason();
+    }
+    return std::string();
+}
+
+std::vector<ATTRIBUTE_TYPE> BindingErrorResponse::getUnknownAttributes() const
+{
+    std::vector<ATTRIBUTE_TYPE> types;
+    UnknownAttributesAttribute* ua = dynamic_cast<UnknownAttributesAttribute*>(findAttribute(AT_UNKNOWN_ATTRIBUTES));
+    if(ua != NULL)
+    {
+        for(size_t i = 0; i < ua->types().size(); ++i)
+        {
+            types.push_back(static_cast<ATTRIBUTE_TYPE>(ua->types()[i]));
+        }
+    }
+    return types;
+}
+
+// Class is 3 to 6 (RFC 5389 15.6), anything else, or no ERROR-CODE,
+// is a malformed response that tells nothing
+bool BindingErrorResponse::isDefinitive() const
+{
+    int cls = errorClass();
+    return cls >= 3 && cls <= 6 && cls != 5;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 /*
@@ -370,6 +942,20 @@ BindingErrorResponse::~BindingErrorResponse()
 
 Attribute* AttributeFactory::fromBuffer(network::Buffer* buf)
 {
+    network::BufferView view(*buf);
+    Attribute* a = fromBuffer(&view);
+    buf->read(buf->readable() - view.readable());
+    return a;
+}
+
+// NULL if the attribute is truncated or malformed
+Attribute* AttributeFactory::fromBuffer(network::BufferView* buf)
+{
+    if(buf->readable() < ATTRIBUTE_HEADER_LENGTH)
+    {
+        return NULL;
+    }
+    
     Attribute* a = NULL;
     unsigned short type = Attribute::checkType(buf);
     switch (type)
@@ -382,12 +968,35 @@ Attribute* AttributeFactory::fromBuffer(network::Buffer* buf)
             a = new AddressAttribute(static_cast<ATTRIBUTE_TYPE>(type));
             break;
             
+        case AT_XOR_MAPPED_ADDRESS:
+            a = new XorAddressAttribute(static_cast<ATTRIBUTE_TYPE>(type));
+            break;
+            
+        case AT_ERROR_CODE:
+            a = new ErrorCodeAttribute();
+            break;
+            
+        case AT_UNKNOWN_ATTRIBUTES:
+            a = new UnknownAttributesAttribute();
+            break;
+            
+        case AT_USER_NAME:
+        case AT_PASS_WORD:
+        case AT_REALM:
+        case AT_NONCE:
+            a = new StringAttribute(static_cast<ATTRIBUTE_TYPE>(type));
+            break;
+            
         default:
             a = new Attribute(static_cast<ATTRIBUTE_TYPE>(type));
             break;
     }
     assert(a != NULL);
-    a->fromBuffer(buf);
+    if(!a->fromBuffer(buf))
+    {
+        delete a;
+        return NULL;
+    }
     return a;
 }
 
@@ -404,8 +1013,13 @@ Attribute* AttributeFactory::fromBuffer(network::Buffer* buf)
  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  |                             Address                           |
  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 
+ The address family is always 0x01, corresponding to IPv4.
+ Port and address are in network byte order, as in sockaddr_in.
  */
 
+#define ADDRESS_FAMILY_IPV4 0x01
+
 AddressAttribute::AddressAttribute(ATTRIBUTE_TYPE type)
 : Attribute(type, 8) // Memory length is fixed to 8 bytes
 {
@@ -416,7 +1030,7 @@ AddressAttribute::AddressAttribute(ATTRIBUTE_TYPE type, const sockaddr_in& sa)
 : Attribute(type, 8) // Memory length is fixed to 8 bytes
 , _address(sa)
 {
-    memset(&_address, 0, sizeof(_address));
+
 }
 
 AddressAttribute::~AddressAttribute()
@@ -430,29 +1044,32 @@ sockaddr_in AddressAttribute::address() const
 }
 
 // Pack into buffer
-size_t AddressAttribute::valueToBuffer(network::Buffer* buf) const
+void AddressAttribute::valueToBuffer(network::BufferWriter* w) const
 {
-    size_t len = buf->write8u(0); // padding
-    len += buf->write8u(_address.sin_family);
-    len += buf->write16u(_address.sin_port);
-    len += buf->write32u(_address.sin_addr.s_addr);
-    assert(len == _length);
-    return len;
+    w->put8u(0); // padding
+    w->put8u(ADDRESS_FAMILY_IPV4);
+    w->putBE16(ntohs(_address.sin_port));
+    w->putBE32(ntohl(_address.sin_addr.s_addr));
 }
 
 // Parse from buffer
-bool AddressAttribute::valueFromBuffer(network::Buffer* buf)
+bool AddressAttribute::valueFromBuffer(network::BufferView* buf)
+{
+    return parse(buf, &_address);
+}
+
+bool AddressAttribute::parse(network::BufferView* buf, sockaddr_in* sa)
 {
-    if(buf->readable() >= length())
+    network::BufferReader r(*buf);
+    if(r.require(8))
     {
-        buf->read8u(); // Discard first 8 bits padding
-        _address.sin_family = buf->read8u();
-        _address.sin_port = buf->read16u();
-        _address.sin_addr.s_addr = buf->read32u();
-        return true;
+        r.get8u(); // Discard first 8 bits padding
+        sa->sin_family = r.get8u() == ADDRESS_FAMILY_IPV4 ? AF_INET : AF_UNSPEC;
+        sa->sin_port = htons(r.getBE16());
+        sa->sin_addr.s_addr = htonl(r.getBE32());
+        buf->read(r.consumed());
     }
-    std::cout << "Buffer size after address read: " << buf->readable() << "\n";
-    return false;
+    return r.good();
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -493,26 +1110,380 @@ ChangeRequestAttribute::~ChangeRequestAttribute()
     
 }
 
-size_t ChangeRequestAttribute::valueToBuffer(network::Buffer* buf) const
+void ChangeRequestAttribute::valueToBuffer(network::BufferWriter* w) const
 {
     unsigned int value = 0;
     value |= _portChange ? 2 : 0;
     value |= _ipChange ? 4 : 0;
-    size_t len = buf->write32u(htonl(value));
-    assert(len == _length);
-    return len;
+    w->putBE32(value);
 }
 
-bool ChangeRequestAttribute::valueFromBuffer(network::Buffer* buf)
+bool ChangeRequestAttribute::valueFromBuffer(network::BufferView* buf)
 {
-    if(buf->readable() >= length())
+    return parse(buf, &_portChange, &_ipChange);
+}
+
+bool ChangeRequestAttribute::parse(network::BufferView* buf, bool* port, bool* ip)
+{
+    network::BufferReader r(*buf);
+    if(r.require(4))
     {
-        unsigned int value = ntohl(buf->read32u());
-        _portChange = (value & 2) >> 1;
-        _ipChange = (value & 4) >> 2;
-        return true;
+        unsigned int value = r.getBE32();
+        *port = (value & 2) >> 1;
+        *ip = (value & 4) >> 2;
+        buf->read(r.consumed());
     }
-    return false;
+    return r.good();
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+/*
+ Value of USERNAME, PASSWORD, REALM and NONCE is text of variable
+ length. RFC 3489 pads it to a multiple of 4 bytes in the value,
+ RFC 5389 keeps the text length and pads after it.
+ */
+
+StringAttribute::StringAttribute(ATTRIBUTE_TYPE type)
+: Attribute(type, 0)
+{
+    
+}
+
+StringAttribute::StringAttribute(ATTRIBUTE_TYPE type, const std::string& value)
+: Attribute(type, value.size())
+, _value(value)
+{
+    
+}
+
+StringAttribute::~StringAttribute()
+{
+    
+}
+
+const std::string& StringAttribute::value() const
+{
+    return _value;
+}
+
+void StringAttribute::valueToBuffer(network::BufferWriter* w) const
+{
+    w->put(reinterpret_cast<const unsigned char*>(_value.data()), _value.size());
+}
+
+bool StringAttribute::valueFromBuffer(network::BufferView* buf)
+{
+    _value.assign(reinterpret_cast<const char*>(buf->read()), buf->readable());
+    buf->read(buf->readable());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+/*
+ RFC 3489
+ 11.2.9 ERROR-CODE
+ The class represents the hundreds digit of the response code.  The
+ value MUST be between 1 and 6.  The number represents the response
+ code modulo 100, and its value MUST be between 0 and 99.
+ 
+ 0                   1                   2                   3
+ 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ |                   0                     |Class|     Number    |
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ |      Reason Phrase (variable)                                ..
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+
+ErrorCodeAttribute::ErrorCodeAttribute()
+: Attribute(AT_ERROR_CODE, 4)
+, _code(0)
+{
+    
+}
+
+ErrorCodeAttribute::ErrorCodeAttribute(int code, const std::string& reason)
+: Attribute(AT_ERROR_CODE, 4 + reason.size())
+, _code(code)
+, _reason(reason)
+{
+    
+}
+
+ErrorCodeAttribute::~ErrorCodeAttribute()
+{
+    
+}
+
+int ErrorCodeAttribute::errorClass() const
+{
+    return _code / 100;
+}
+
+int ErrorCodeAttribute::errorNumber() const
+{
+    return _code % 100;
+}
+
+int ErrorCodeAttribute::errorCode() const
+{
+    return _code;
+}
+
+const std::string& ErrorCodeAttribute::reason() const
+{
+    return _reason;
+}
+
+void ErrorCodeAttribute::valueToBuffer(network::BufferWriter* w) const
+{
+    w->putBE16(0);
+    w->put8u(static_cast<uint8_t>(errorClass() & 0x07));
+    w->put8u(static_cast<uint8_t>(errorNumber()));
+    w->put(reinterpret_cast<const unsigned char*>(_reason.data()), _reason.size());
+}
+
+bool ErrorCodeAttribute::valueFromBuffer(network::BufferView* buf)
+{
+    network::StringView reason;
+    if(!parse(buf, &_code, &reason))
+    {
+        return false;
+    }
+    _reason = reason.toString();
+    return true;
+}
+
+bool ErrorCodeAttribute::parse(network::BufferView* buf, int* code, network::StringView* reason)
+{
+    network::BufferReader r(*buf);
+    if(!r.require(4))
+    {
+        return false;
+    }
+    
+    r.getBE16(); // Discard 21 bits zero
+    int errorClass = r.get8u() & 0x07;
+    int errorNumber = r.get8u();
+    if(errorNumber > 99)
+    {
+        return false;
+    }
+    
+    *code = errorClass * 100 + errorNumber;
+    *reason = network::StringView(reinterpret_cast<const char*>(r.read()), r.readable());
+    buf->read(buf->readable());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+/*
+ RFC 3489
+ 11.2.10 UNKNOWN-ATTRIBUTES
+ The attribute contains a list of 16 bit values, each of which
+ represents an attribute type that was not understood by the server.
+ If the number of unknown attributes is an odd number, one of the
+ attributes MUST be repeated in the list, so that the total length of
+ the list is a multiple of 4 bytes.
+ */
+
+UnknownAttributesAttribute::UnknownAttributesAttribute()
+: Attribute(AT_UNKNOWN_ATTRIBUTES, 0)
+{
+    
+}
+
+UnknownAttributesAttribute::UnknownAttributesAttribute(const std::vector<unsigned short>& types)
+: Attribute(AT_UNKNOWN_ATTRIBUTES, types.size() * 2)
+, _types(types)
+{
+    
+}
+
+UnknownAttributesAttribute::~UnknownAttributesAttribute()
+{
+    
+}
+
+const std::vector<unsigned short>& UnknownAttributesAttribute::types() const
+{
+    return _types;
+}
+
+void UnknownAttributesAttribute::valueToBuffer(network::BufferWriter* w) const
+{
+    for(size_t i = 0; i < _types.size(); ++i)
+    {
+        w->putBE16(_types[i]);
+    }
+}
+
+bool UnknownAttributesAttribute::valueFromBuffer(network::BufferView* buf)
+{
+    _types.resize(buf->readable() / 2);
+    if(!_types.empty())
+    {
+        parse(buf, &_types[0], _types.size());
+    }
+    return true;
+}
+
+size_t UnknownAttributesAttribute::parse(network::BufferView* buf, unsigned short* types, size_t n)
+{
+    n = std::min(n, buf->readable() / 2);
+    buf->readBE16Array(types, n);
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+/*
+ RFC 5389
+ 15.2.  XOR-MAPPED-ADDRESS
+ 
+ 0                   1                   2                   3
+ 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ |x x x x x x x x|    Family     |         X-Port                |
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ |                X-Address (Variable)
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ 
+ X-Port is computed by taking the mapped port in host byte order,
+ XOR'ing it with the most significant 16 bits of the magic cookie.
+ If the IP address family is IPv4, X-Address is computed by taking
+ the mapped IP address in host byte order, XOR'ing it with the magic
+ cookie.  If the IP address family is IPv6, X-Address is computed by
+ taking the mapped IP address in host byte order, XOR'ing it with the
+ concatenation of the magic cookie and the 96-bit transaction ID.
+ 
+ As bytes in network order, port and address are XOR'ed from the
+ start of the 16 bytes key: magic cookie, then bytes 4-15 of tid.
+ */
+
+#define ADDRESS_FAMILY_IPV6 0x02
+
+// XOR port and address with the key made from the transaction ID
+static void xorAddress(unsigned char* value, size_t n, const unsigned char* tid)
+{
+    unsigned char key[16];
+    network::storeBE32(key, MAGIC_COOKIE);
+    memcpy(key + 4, tid + 4, 12);
+    
+    value[0] ^= key[0]; // X-Port
+    value[1] ^= key[1];
+    for(size_t i = 2; i < n; ++i)
+    {
+        value[i] ^= key[i - 2]; // X-Address
+    }
+}
+
+XorAddressAttribute::XorAddressAttribute(ATTRIBUTE_TYPE type)
+: Attribute(type, 8)
+, _family(ADDRESS_FAMILY_IPV4)
+{
+    memset(_value, 0, sizeof(_value));
+}
+
+XorAddressAttribute::XorAddressAttribute(ATTRIBUTE_TYPE type, const sockaddr* sa, const network::UUID& tid)
+: Attribute(type, 8)
+, _family(ADDRESS_FAMILY_IPV4)
+{
+    memset(_value, 0, sizeof(_value));
+    if(sa->sa_family == AF_INET6)
+    {
+        const sockaddr_in6* sin6 = reinterpret_cast<const sockaddr_in6*>(sa);
+        _family = ADDRESS_FAMILY_IPV6;
+        _length = 20;
+        memcpy(_value, &sin6->sin6_port, 2);
+        memcpy(_value + 2, &sin6->sin6_addr, 16);
+    }
+    else
+    {
+        const sockaddr_in* sin = reinterpret_cast<const sockaddr_in*>(sa);
+        memcpy(_value, &sin->sin_port, 2);
+        memcpy(_value + 2, &sin->sin_addr, 4);
+    }
+    xorAddress(_value, _length - 2, tid.bytes());
+}
+
+XorAddressAttribute::~XorAddressAttribute()
+{
+    
+}
+
+bool XorAddressAttribute::address(const network::UUID& tid, sockaddr_storage* sa) const
+{
+    unsigned char value[4 + sizeof(_value)];
+    value[0] = 0;
+    value[1] = _family;
+    memcpy(value + 2, _value, _length - 2);
+    network::BufferView view(value, _length);
+    return parse(&view, tid.bytes(), sa);
+}
+
+void XorAddressAttribute::valueToBuffer(network::BufferWriter* w) const
+{
+    w->put8u(0); // padding
+    w->put8u(_family);
+    w->put(_value, _length - 2);
+}
+
+bool XorAddressAttribute::valueFromBuffer(network::BufferView* buf)
+{
+    network::BufferReader r(*buf);
+    if(r.require(4))
+    {
+        r.get8u(); // Discard first 8 bits padding
+        _family = r.get8u();
+        if(r.require(_family == ADDRESS_FAMILY_IPV6 ? 18 : 6))
+        {
+            _length = _family == ADDRESS_FAMILY_IPV6 ? 20 : 8;
+            memcpy(_value, r.get(_length - 2), _length - 2);
+            buf->read(r.consumed());
+        }
+    }
+    return r.good();
+}
+
+bool XorAddressAttribute::parse(network::BufferView* buf, const unsigned char* tid, sockaddr_storage* sa)
+{
+    network::BufferReader r(*buf);
+    if(!r.require(4))
+    {
+        return false;
+    }
+    
+    r.get8u(); // Discard first 8 bits padding
+    unsigned char family = r.get8u();
+    unsigned char value[18];
+    size_t n = family == ADDRESS_FAMILY_IPV6 ? 18 : 6;
+    if(!r.readBlob(value, n))
+    {
+        return false;
+    }
+    xorAddress(value, n, tid);
+    
+    memset(sa, 0, sizeof(sockaddr_storage));
+    if(family == ADDRESS_FAMILY_IPV6)
+    {
+        sockaddr_in6* sin6 = reinterpret_cast<sockaddr_in6*>(sa);
+        sin6->sin6_family = AF_INET6;
+        memcpy(&sin6->sin6_port, value, 2);
+        memcpy(&sin6->sin6_addr, value + 2, 16);
+    }
+    else
+    {
+        sockaddr_in* sin = reinterpret_cast<sockaddr_in*>(sa);
+        sin->sin_family = family == ADDRESS_FAMILY_IPV4 ? AF_INET : AF_UNSPEC;
+        memcpy(&sin->sin_port, value, 2);
+        memcpy(&sin->sin_addr, value + 2, 4);
+    }
+    buf->read(r.consumed());
+    return true;
 }
 
 STUN_END
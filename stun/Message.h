@@ -12,6 +12,9 @@
 #include <stun/Config.h>
 #include <stun/UUID.h>
 #include <stun/Buffer.h>
+#include <stun/BufferView.h>
+#include <stun/BufferWriter.h>
+#include <stun/Credential.h>
 
 STUN_BEGIN
 
@@ -41,6 +44,29 @@ STUN_BEGIN
 
 #define MESSAGE_HEADER_LENGTH 20
 
+/*
+ RFC 5389 (October 2008)
+ 6.  STUN Message Structure
+ The magic cookie field MUST contain the fixed value 0x2112A442 in
+ network byte order.  In RFC 3489, this field was part of the
+ transaction ID; placing the magic cookie in this location allows
+ a server to detect if the client will understand certain attributes
+ that were added in this revised specification.
+ 
+ Here the cookie is kept as the first 4 bytes of the 16 bytes
+ transaction ID. RFC 3489 servers take it as part of an opaque
+ transaction ID, so requests always carry it.
+ */
+
+#define MAGIC_COOKIE 0x2112A442
+
+/*
+ Messages should stay below 548 bytes to avoid IP fragmentation,
+ a buffer of this size holds any message of this codec.
+ */
+
+#define MESSAGE_BUFFER_SIZE 576
+
 /*
  The Message Types can take on the following values:
  0x0001  :  Binding Request
@@ -59,6 +85,35 @@ enum MESSAGE_TYPE
     MT_SHARED_SECRET_RESPONSE       = 0x0102,
     MT_SHARED_SECRET_ERROR_RESPONSE = 0x0112
 };
+
+/*
+ RFC 5389
+ 6.  STUN Message Structure
+ The most significant 2 bits of every STUN message MUST be zeroes.
+ This can be used to differentiate STUN packets from other protocols
+ when STUN is multiplexed with other protocols on the same port.
+ 
+ 0                 1
+ 2  3  4 5 6 7 8 9 0 1 2 3 4 5
+ +--+--+-+-+-+-+-+-+-+-+-+-+-+-+
+ |M |M |M|M|M|C|M|M|M|C|M|M|M|M|
+ |11|10|9|8|7|1|6|5|4|0|3|2|1|0|
+ +--+--+-+-+-+-+-+-+-+-+-+-+-+-+
+ 
+ Class bits C1 and C0 are masked off to get the method.
+ */
+
+#define MESSAGE_METHOD_BITS 0x3EEF
+#define METHOD_BINDING 0x0001
+#define METHOD_SHARED_SECRET 0x0002
+
+// Result of Message::classify()
+enum MESSAGE_VERSION
+{
+    MV_NONE     = 0,    // Not STUN
+    MV_RFC3489  = 1,    // Plausible STUN, no magic cookie
+    MV_RFC5389  = 2     // STUN with magic cookie
+};
     
 /*
  RFC 3489 (March 2003)
@@ -76,6 +131,19 @@ enum MESSAGE_TYPE
  */
 
 #define ATTRIBUTE_HEADER_LENGTH 4
+
+/*
+ RFC 5389
+ 15.  STUN Attributes
+ Since STUN aligns attributes on 32-bit boundaries, attributes whose
+ content is not a multiple of 4 bytes are padded with 1, 2, or 3 bytes
+ of padding so that its value contains a multiple of 4 bytes.  The
+ padding bits are ignored, and may be any value.
+ 
+ Values of RFC 3489 attributes are multiples of 4 bytes, no padding.
+ */
+
+#define ATTRIBUTE_PADDED_LENGTH(n) (((n) + 3) & ~static_cast<size_t>(3))
     
 /*
  The following types are defined:
@@ -90,6 +158,12 @@ enum MESSAGE_TYPE
  0x0009: ERROR-CODE
  0x000a: UNKNOWN-ATTRIBUTES
  0x000b: REFLECTED-FROM
+ 
+ RFC 5389 adds:
+ 0x0014: REALM
+ 0x0015: NONCE
+ 0x0020: XOR-MAPPED-ADDRESS
+ 0x8028: FINGERPRINT
  */
     
 enum ATTRIBUTE_TYPE
@@ -104,8 +178,14 @@ enum ATTRIBUTE_TYPE
     AT_MESSAGE_INTEGRITY    = 0x0008,
     AT_ERROR_CODE           = 0x0009,
     AT_UNKNOWN_ATTRIBUTES   = 0x000a,
-    AT_REFLECTED_FROM       = 0x000b
+    AT_REFLECTED_FROM       = 0x000b,
+    AT_REALM                = 0x0014,
+    AT_NONCE                = 0x0015,
+    AT_XOR_MAPPED_ADDRESS   = 0x0020,
+    AT_FINGERPRINT          = 0x8028
 };
+
+#define MESSAGE_INTEGRITY_LENGTH 20 // HMAC-SHA1
     
 class Attribute
 {
@@ -114,15 +194,19 @@ public:
     virtual ~Attribute();
         
     unsigned short type() const;
-    size_t length() const;
+    size_t length() const; // Memory length of value, not padded
     
     // Pack into buffer
+    // Check w->good() after packing into raw memory
     size_t toBuffer(network::Buffer* buf) const;
+    void toBuffer(network::BufferWriter* w) const;
     bool fromBuffer(network::Buffer* buf);
+    bool fromBuffer(network::BufferView* buf); // Parse without copy
     
     // Attribute define the memory format
     // so knows how to parse type field
     static unsigned short checkType(network::Buffer* buf);
+    static unsigned short checkType(network::BufferView* buf);
     
 protected:
     Attribute();
@@ -132,8 +216,9 @@ protected:
     
     // Pack and unpack value
     // Redefined by derived class
-    virtual size_t valueToBuffer(network::Buffer* buf) const;
-    virtual bool valueFromBuffer(network::Buffer* buf);
+    // Room of length() bytes is checked before packing value
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
 };
     
 class Message
@@ -146,33 +231,101 @@ public:
     // Fields of message header
     MESSAGE_TYPE type() const;
     network::UUID tid() const;
+    bool hasMagicCookie() const; // RFC 5389 message
+    
+    // Random transaction ID from the generator of the calling thread
+    // Led by the magic cookie (RFC 5389), or 128 random bits (RFC 3489)
+    static network::UUID newTid(bool cookie = true);
+    
+    // Add FINGERPRINT as the last attribute when packing
+    void setFingerprint(bool fingerprint = true);
+    bool hasFingerprint() const;
+    
+    // Check FINGERPRINT as the last 8 bytes of the n bytes message at b
+    static bool checkFingerprint(const unsigned char* b, size_t n);
+    
+    // Add MESSAGE-INTEGRITY with the key of credential when packing
+    // The credential must outlive the message, NULL to remove
+    void setCredential(const Credential* credential);
+    
+    // Check received MESSAGE-INTEGRITY, false if not present
+    bool checkIntegrity(const Credential& credential) const;
+    
+    // Check MESSAGE-INTEGRITY as the last 24 bytes of the n bytes message at b
+    static bool checkIntegrity(const unsigned char* b, size_t n, const Credential& credential);
+    
+    // Memory length of message, header included
+    size_t size() const;
     
     // Pack into buffer
+    // Size is calculated once, then the message is packed at once
+    // Packing into raw memory returns 0 if the message does not fit,
+    // so it can pack into a stack array or a slot of a sendmmsg batch
+    // In lazy mode, attributes are only indexed when parsing, and are
+    // decoded on first access
     size_t toBuffer(network::Buffer* buf) const;
-    bool fromBuffer(network::Buffer* buf);
+    size_t toBuffer(unsigned char* b, size_t n) const;
+    void toBuffer(network::BufferWriter* w) const; // Check w->good() after packing
+    bool fromBuffer(network::Buffer* buf, bool lazy = false);
+    bool fromBuffer(network::BufferView* buf, bool lazy = false); // Parse without copy
+    
+    // Pack header and attributes separately, to be sent as a BufferChain
+    // length is the memory length of all attributes that follow the header
+    // FINGERPRINT is not added, it is only packed by toBuffer()
+    size_t headerToBuffer(network::Buffer* buf, size_t length) const;
+    size_t attributesToBuffer(network::Buffer* buf) const;
+    void headerToBuffer(network::BufferWriter* w, size_t length) const;
+    void attributesToBuffer(network::BufferWriter* w) const;
     
     virtual std::string toString() const;
     
     static unsigned short checkType(network::Buffer* buf);
+    static unsigned short checkType(network::BufferView* buf);
+    
+    // Tell a STUN datagram from other protocols on the same socket
+    // (RTP, DTLS) by its header only, with no allocation
+    // n is the size of the whole datagram
+    // Check FINGERPRINT too for a stronger answer
+    static MESSAGE_VERSION classify(const unsigned char* b, size_t n);
     
 protected:
     Message();
     
     MESSAGE_TYPE _type;
     network::UUID _tid;
+    bool _fingerprint;
+    const Credential* _credential;
     
-    std::vector<Attribute*> _attributes;
+    // Attribute in wire order, decoded, or raw until accessed in lazy mode
+    struct AttributeEntry
+    {
+        Attribute* attribute; // NULL if not decoded yet
+        unsigned short type;
+        unsigned short offset; // Offset of attribute header in _raw
+        unsigned short length; // Memory length of attribute, header included
+    };
+    
+    mutable std::vector<AttributeEntry> _attributes;
     
     size_t length() const; // Calculate length of all attributes
     void setAttribute(Attribute* attribute);
     Attribute* findAttribute(ATTRIBUTE_TYPE type) const;
     
+private:
+    std::vector<unsigned char> _raw; // Copy of attributes in lazy mode
+    std::vector<unsigned char> _integrity; // Received bytes up to end of MESSAGE-INTEGRITY
+    
+    bool indexAttributes(const unsigned char* message, const network::BufferView& attributes);
+    void pack(network::BufferWriter* w, size_t length) const;
+    Attribute* decodeAttribute(size_t i) const; // Decode raw entry i, remove it if malformed
+    bool keepIntegrity(const unsigned char* message, size_t n);
 };
     
 class MessageFactory
 {
 public:
-    static Message* fromBuffer(network::Buffer* buf);
+    static Message* fromBuffer(network::Buffer* buf, bool lazy = false);
+    static Message* fromBuffer(network::BufferView* buf, bool lazy = false);
 };
 
 class BindingRequest : public Message
@@ -185,7 +338,13 @@ public:
     void setResponseAddress(const sockaddr_in& sa);
     void setChangeRequest(bool port, bool ip = false);
     void setUserName(const std::string& name);
-    void setMessageIntegrity();
+    void setRealm(const std::string& realm);
+    void setNonce(const std::string& nonce);
+    
+    // Add USERNAME (and REALM) of credential if not set,
+    // MESSAGE-INTEGRITY is added when packing
+    // The credential must outlive the request
+    void setMessageIntegrity(const Credential& credential);
 };
 
 class BindingResponse : public Message
@@ -195,11 +354,12 @@ public:
     virtual ~BindingResponse();
     
     // Attributes
-    sockaddr_in mappedAddress() const;
+    sockaddr_in mappedAddress() const; // XOR-MAPPED-ADDRESS first if IPv4
+    bool xorMappedAddress(sockaddr_storage* sa) const;
     sockaddr_in sourceAddress() const;
     sockaddr_in changedAddress() const;
     sockaddr_in reflectedFrom() const;
-    bool messageIntegrity() const;
+    bool messageIntegrity(const Credential& credential) const;
 };
 
 class BindingErrorResponse : public Message
@@ -211,16 +371,22 @@ public:
     //Attributes
     int errorClass() const;
     int errorNumber() const;
-    int errorCode() const;
-    std::string errorReason();
+    int errorCode() const; // 0 if not present
+    std::string errorReason() const;
     
     std::vector<ATTRIBUTE_TYPE> getUnknownAttributes() const;
+    
+    // Errors that a retransmit may not fix, e.g. 420 Unknown Attribute
+    // Server errors (5xx) are transient, malformed responses (no ERROR-CODE)
+    // are not definitive either
+    bool isDefinitive() const;
 };
     
 class AttributeFactory
 {
 public:
     static Attribute* fromBuffer(network::Buffer* buf);
+    static Attribute* fromBuffer(network::BufferView* buf);
 };
     
 class AddressAttribute : public Attribute
@@ -233,8 +399,11 @@ public:
     sockaddr_in address() const;
 
     // Customized packing and parsing of value
-    virtual size_t valueToBuffer(network::Buffer* buf) const;
-    virtual bool valueFromBuffer(network::Buffer* buf);
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+    // Parse value into sa, without an attribute object
+    static bool parse(network::BufferView* buf, sockaddr_in* sa);
     
 private:
     // Attribute value
@@ -248,14 +417,102 @@ public:
     virtual ~ChangeRequestAttribute();
     
     // Customized packing and parsing for value
-    virtual size_t valueToBuffer(network::Buffer* buf) const;
-    virtual bool valueFromBuffer(network::Buffer* buf);
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+    // Parse value into flags, without an attribute object
+    static bool parse(network::BufferView* buf, bool* port, bool* ip);
     
 private:
     bool _portChange;
     bool _ipChange;
 };
 
+// USERNAME, PASSWORD, REALM, NONCE
+class StringAttribute : public Attribute
+{
+public:
+    StringAttribute(ATTRIBUTE_TYPE type);
+    StringAttribute(ATTRIBUTE_TYPE type, const std::string& value);
+    virtual ~StringAttribute();
+    
+    const std::string& value() const;
+    
+    // Customized packing and parsing of value
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+private:
+    std::string _value;
+};
+
+class ErrorCodeAttribute : public Attribute
+{
+public:
+    ErrorCodeAttribute();
+    ErrorCodeAttribute(int code, const std::string& reason);
+    virtual ~ErrorCodeAttribute();
+    
+    int errorClass() const;
+    int errorNumber() const;
+    int errorCode() const; // Class * 100 + number
+    const std::string& reason() const;
+    
+    // Customized packing and parsing of value
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+    // Parse value without copy, reason refers to the parsed memory
+    static bool parse(network::BufferView* buf, int* code, network::StringView* reason);
+    
+private:
+    int _code;
+    std::string _reason;
+};
+
+class UnknownAttributesAttribute : public Attribute
+{
+public:
+    UnknownAttributesAttribute();
+    UnknownAttributesAttribute(const std::vector<unsigned short>& types);
+    virtual ~UnknownAttributesAttribute();
+    
+    const std::vector<unsigned short>& types() const;
+    
+    // Customized packing and parsing of value
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+    // Parse up to n types into array, returns number of types parsed
+    static size_t parse(network::BufferView* buf, unsigned short* types, size_t n);
+    
+private:
+    std::vector<unsigned short> _types;
+};
+
+class XorAddressAttribute : public Attribute
+{
+public:
+    XorAddressAttribute(ATTRIBUTE_TYPE type);
+    XorAddressAttribute(ATTRIBUTE_TYPE type, const sockaddr* sa, const network::UUID& tid);
+    virtual ~XorAddressAttribute();
+    
+    // Address is obfuscated with the transaction ID of its message
+    bool address(const network::UUID& tid, sockaddr_storage* sa) const;
+    
+    // Customized packing and parsing of value
+    virtual void valueToBuffer(network::BufferWriter* w) const;
+    virtual bool valueFromBuffer(network::BufferView* buf);
+    
+    // Parse value into sa, with the 16 bytes transaction ID
+    static bool parse(network::BufferView* buf, const unsigned char* tid, sockaddr_storage* sa);
+    
+private:
+    // Value as on the wire
+    unsigned char _family;
+    unsigned char _value[18]; // X-Port and X-Address
+};
+
 STUN_END
 
 #endif
@@ -6,12 +6,36 @@
 //
 
 #include "Network.h"
+#include "BufferChain.h"
+#include "DatagramBatch.h"
 #include <cassert>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 NETWORK_BEGIN
 
+#if !defined(_WIN32)
+
+// The kernel reports the total of the socket, and only once it is not 0
+uint32_t dropCount(struct msghdr* msg)
+{
+#if defined(SO_RXQ_OVFL)
+    for(struct cmsghdr* c = CMSG_FIRSTHDR(msg); c != NULL; c = CMSG_NXTHDR(msg, c))
+    {
+        if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+        {
+            uint32_t n;
+            memcpy(&n, CMSG_DATA(c), sizeof(n));
+            return n;
+        }
+    }
+#endif
+    return 0;
+}
+
+#endif
+
 bool startup()
 {
 #ifdef _WIN32
@@ -115,15 +139,22 @@ std::vector<struct in_addr> getLocalAddress()
 }
 
 UdpSocket::UdpSocket()
+: _dropCounter(false)
+, _drops(0)
 {
     memset(&_sin, 0, sizeof(_sin));
 	_sin.sin_family = AF_INET;
 
     _socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-	assert(_socket != INVALID_SOCKET);
+    if(_socket == INVALID_SOCKET)
+    {
+        std::cerr << "UdpSocket::UdpSocket() failed!\n";
+    }
 }
 
 UdpSocket::UdpSocket(const std::string& host, unsigned short port)
+: _dropCounter(false)
+, _drops(0)
 {
     memset(&_sin, 0, sizeof(_sin));
 	_sin.sin_family = AF_INET;
@@ -131,11 +162,18 @@ UdpSocket::UdpSocket(const std::string& host, unsigned short port)
 	_sin.sin_addr.s_addr = resolveHostName(host).s_addr;
  
     _socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-	assert(_socket != INVALID_SOCKET);
+    if(_socket == INVALID_SOCKET)
+    {
+        std::cerr << "UdpSocket::UdpSocket() failed!\n";
+    }
 }
 
 UdpSocket::~UdpSocket()
 {
+    if(_socket == INVALID_SOCKET)
+    {
+        return;
+    }
 #if defined(_WIN32)
     int error = WSAGetLastError();
     closesocket(_socket);
@@ -182,34 +220,186 @@ ssize_t UdpSocket::write(const unsigned char* buf, size_t size)
 	return ::sendto(_socket, buf, size, 0, (struct sockaddr*)&_sin, sizeof(_sin));
 }
 
+ssize_t UdpSocket::write(BufferChain* chain)
+{
+    struct sockaddr_storage ss;
+    memset(&ss, 0, sizeof(ss));
+    memcpy(&ss, &_sin, sizeof(_sin));
+    return chain->sendTo(_socket, &ss);
+}
+
 ssize_t UdpSocket::read(unsigned char* buf, size_t size)
 {
-    struct sockaddr_in sin;
-    memset(&sin, 0, sizeof(sin));
-    socklen_t len = sizeof(sin);
-	return ::recvfrom(_socket, buf, size, 0, (struct sockaddr*)&sin, &len);
+    return receive(buf, size);
 }
 
 ssize_t UdpSocket::read(unsigned char* buf, size_t size, int timeout)
 {
-    struct timeval tv;
-    tv.tv_sec = timeout / 1000;
-    tv.tv_usec = (timeout % 1000) * 1000;
-	
-	fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_socket, &fds);
-    
-    int rc = ::select(sizeof(fds)*8, &fds, NULL, NULL, &tv);
-    if(rc > 0 && FD_ISSET(_socket, &fds))
+    if(wait(timeout))
     {
-	    struct sockaddr_in sin;
-	    memset(&sin, 0, sizeof(sin));
-	    socklen_t len = sizeof(sin);
-		return ::recvfrom(_socket, buf, size, 0, (struct sockaddr*)&sin, &len);
+        return receive(buf, size);
 	}
 	
 	return -1;
 }
 
+ssize_t UdpSocket::receive(unsigned char* buf, size_t size)
+{
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    socklen_t len = sizeof(sin);
+#if defined(__linux) && defined(SO_RXQ_OVFL)
+    if(_dropCounter)
+    {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        
+        unsigned char control[CMSG_SPACE(sizeof(uint32_t))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &sin;
+        msg.msg_namelen = len;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        ssize_t rc = ::recvmsg(_socket, &msg, 0);
+        if(rc >= 0)
+        {
+            _drops = std::max(_drops, dropCount(&msg));
+        }
+        return rc;
+    }
+#endif
+	return ::recvfrom(_socket, (char*)buf, size, 0, (struct sockaddr*)&sin, &len);
+}
+
+ssize_t UdpSocket::write(DatagramBatch* batch)
+{
+    assert(batch != NULL);
+    return batch->sendTo(_socket);
+}
+
+ssize_t UdpSocket::read(DatagramBatch* batch)
+{
+    assert(batch != NULL);
+    return batch->receiveFrom(_socket, _dropCounter ? &_drops : NULL);
+}
+
+ssize_t UdpSocket::read(DatagramBatch* batch, int timeout)
+{
+    assert(batch != NULL);
+    if(wait(timeout))
+    {
+        return batch->receiveFrom(_socket, _dropCounter ? &_drops : NULL);
+    }
+    
+    batch->clear();
+    return -1;
+}
+
+bool UdpSocket::setOption(int level, int name, int value)
+{
+    if(::setsockopt(_socket, level, name, (const char*)&value, sizeof(value)) == SOCKET_ERROR)
+    {
+        std::cerr << "UdpSocket::setOption(" << level << ", " << name << ") failed!\n";
+        return false;
+    }
+    return true;
+}
+
+// -1 if failed
+int UdpSocket::option(int level, int name) const
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if(::getsockopt(_socket, level, name, (char*)&value, &len) == SOCKET_ERROR)
+    {
+        return -1;
+    }
+    return value;
+}
+
+bool UdpSocket::setReceiveBufferSize(int size)
+{
+    return setOption(SOL_SOCKET, SO_RCVBUF, size);
+}
+
+int UdpSocket::receiveBufferSize() const
+{
+    return option(SOL_SOCKET, SO_RCVBUF);
+}
+
+bool UdpSocket::setSendBufferSize(int size)
+{
+    return setOption(SOL_SOCKET, SO_SNDBUF, size);
+}
+
+int UdpSocket::sendBufferSize() const
+{
+    return option(SOL_SOCKET, SO_SNDBUF);
+}
+
+bool UdpSocket::setBusyPoll(int usec)
+{
+#if defined(__linux) && defined(SO_BUSY_POLL)
+    return setOption(SOL_SOCKET, SO_BUSY_POLL, usec);
+#else
+    return false;
+#endif
+}
+
+bool UdpSocket::setTypeOfService(int tos)
+{
+    return setOption(IPPROTO_IP, IP_TOS, tos);
+}
+
+bool UdpSocket::setNonBlocking(bool nonblocking)
+{
+#if defined(_WIN32)
+    u_long mode = nonblocking ? 1 : 0;
+    return ::ioctlsocket(_socket, FIONBIO, &mode) == 0;
+#else
+    int flags = ::fcntl(_socket, F_GETFL, 0);
+    if(flags < 0)
+    {
+        return false;
+    }
+    flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return ::fcntl(_socket, F_SETFL, flags) == 0;
+#endif
+}
+
+bool UdpSocket::setDropCounter(bool enable)
+{
+#if defined(__linux) && defined(SO_RXQ_OVFL)
+    if(!setOption(SOL_SOCKET, SO_RXQ_OVFL, enable ? 1 : 0))
+    {
+        return false;
+    }
+    _dropCounter = enable;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// poll() has no FD_SETSIZE limit and costs nothing per unused descriptor
+bool UdpSocket::wait(int timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = _socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    
+#if defined(_WIN32)
+    int rc = ::WSAPoll(&pfd, 1, timeout);
+#else
+    int rc = ::poll(&pfd, 1, timeout);
+#endif
+    return rc > 0 && (pfd.revents & (POLLIN | POLLERR)) != 0;
+}
+
 NETWORK_END
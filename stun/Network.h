@@ -10,6 +10,7 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -38,6 +39,9 @@ typedef int socklen_t;
 #   define INVALID_SOCKET	-1
 #endif
 
+// Largest datagram expected on an Ethernet path
+#define MAX_DATAGRAM_SIZE 1500
+
 #define NETWORK_NAMESPACE
 
 #ifdef NETWORK_NAMESPACE
@@ -50,6 +54,9 @@ typedef int socklen_t;
 
 NETWORK_BEGIN
 
+class BufferChain;
+class DatagramBatch;
+
 bool startup();
 void cleanup();
 
@@ -57,6 +64,11 @@ std::string addressToString(const struct sockaddr_in& sin);
 struct in_addr resolveHostName(const std::string& name);
 std::vector<struct in_addr> getLocalAddress();
 
+#if !defined(_WIN32)
+// Kernel drop count (SO_RXQ_OVFL) in control data of a received message, 0 if none
+uint32_t dropCount(struct msghdr* msg);
+#endif
+
 class UdpSocket
 {        
 public:
@@ -64,6 +76,47 @@ public:
 	UdpSocket(const std::string& host, unsigned short port); // Remote address
 	virtual ~UdpSocket();
     
+    // Descriptor, to watch with EventLoop
+    SOCKET fd() const
+    {
+        return _socket;
+    }
+    
+    // Socket was created, calls on a failed socket return errors
+    bool valid() const
+    {
+        return _socket != INVALID_SOCKET;
+    }
+    
+    //
+    // Socket options, return false if failed or not supported
+    // Buffer sizes are as the kernel reports, Linux doubles the set size
+    //
+    
+    bool setReceiveBufferSize(int size);
+    int receiveBufferSize() const;
+    bool setSendBufferSize(int size);
+    int sendBufferSize() const;
+    
+    // Busy poll the device for up to usec on blocking reads (Linux)
+    bool setBusyPoll(int usec);
+    
+    // Type of service byte of sent packets, e.g. DSCP << 2
+    bool setTypeOfService(int tos);
+    
+    // Reads and writes return at once, -1 if they would block
+    bool setNonBlocking(bool nonblocking = true);
+    
+    // Count datagrams the kernel dropped for a full receive buffer
+    // (SO_RXQ_OVFL, Linux), reported with each read
+    bool setDropCounter(bool enable = true);
+    
+    // Dropped datagrams as last reported, 0 if not counted
+    uint32_t drops() const
+    {
+        return _drops;
+    }
+    
     sockaddr_in localAddress();
     sockaddr_in remoteAddress();
     
@@ -71,12 +124,31 @@ public:
     void setRemoteAddress(const struct sockaddr_in& sin);
     
 	ssize_t write(const unsigned char* buf, size_t size);
+	ssize_t write(BufferChain* chain); // All segments in one datagram
 	ssize_t read(unsigned char* buf, size_t size);
 	ssize_t read(unsigned char* buf, size_t size, int timeout);
+    
+    // Datagrams of batch to their own addresses, returns number sent
+    ssize_t write(DatagramBatch* batch);
+    
+    // Up to capacity of batch, returns number received
+    ssize_t read(DatagramBatch* batch);
+    ssize_t read(DatagramBatch* batch, int timeout);
 
 private:
 	SOCKET _socket;
 	sockaddr_in _sin;
+    bool _dropCounter;
+    uint32_t _drops;
+    
+    // Wait until readable, false if timeout or failed
+    bool wait(int timeout);
+    
+    // Receive one datagram, with drop count if enabled
+    ssize_t receive(unsigned char* buf, size_t size);
+    
+    bool setOption(int level, int name, int value);
+    int option(int level, int name) const;
 };
 
 NETWORK_END
@@ -0,0 +1,195 @@
+//
+//  ParsedMessage.cpp
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "ParsedMessage.h"
+#include <stun/BufferReader.h>
+
+STUN_BEGIN
+
+ParsedMessage::ParsedMessage()
+: _data(NULL)
+, _size(0)
+, _type(0)
+, _count(0)
+{
+    
+}
+
+ParsedMessage::~ParsedMessage()
+{
+    
+}
+
+bool ParsedMessage::parse(const network::BufferView& buf)
+{
+    return parse(buf.read(), buf.readable());
+}
+
+bool ParsedMessage::parse(const unsigned char* b, size_t n)
+{
+    _data = NULL;
+    _size = 0;
+    _count = 0;
+    
+    network::BufferReader r(b, n);
+    if(!r.require(MESSAGE_HEADER_LENGTH))
+    {
+        return false;
+    }
+    
+    // Header
+    _type = r.getBE16();
+    size_t length = r.getBE16();
+    r.get(16); // Transaction ID
+    if(!r.require(length))
+    {
+        return false;
+    }
+    
+    // Attributes
+    // Entries count only once all are indexed, a failed parse has none
+    network::BufferReader attributes(r.get(length), length);
+    size_t count = 0;
+    bool integrity = false;
+    while(attributes.readable() > 0)
+    {
+        if(count == MAX_PARSED_ATTRIBUTES || !attributes.require(ATTRIBUTE_HEADER_LENGTH))
+        {
+            return false;
+        }
+        
+        Entry& e = _entries[count];
+        e.type = attributes.getBE16();
+        e.length = attributes.getBE16();
+        e.offset = static_cast<unsigned short>(MESSAGE_HEADER_LENGTH + attributes.consumed());
+        if(!attributes.skip(ATTRIBUTE_PADDED_LENGTH(e.length)))
+        {
+            return false;
+        }
+        
+        // Attributes after MESSAGE-INTEGRITY are ignored but FINGERPRINT (RFC 5389 15.4)
+        if(integrity && e.type != AT_FINGERPRINT)
+        {
+            continue;
+        }
+        integrity = integrity || e.type == AT_MESSAGE_INTEGRITY;
+        ++count;
+    }
+    
+    _data = b;
+    _count = count;
+    _size = MESSAGE_HEADER_LENGTH + length;
+    return true;
+}
+
+bool ParsedMessage::findAttribute(ATTRIBUTE_TYPE type, network::BufferView* value) const
+{
+    for(size_t i = 0; i < _count; ++i)
+    {
+        if(_entries[i].type == type)
+        {
+            *value = network::BufferView(_data + _entries[i].offset, _entries[i].length);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParsedMessage::address(ATTRIBUTE_TYPE type, sockaddr_in* sa) const
+{
+    network::BufferView value;
+    if(!findAttribute(type, &value))
+    {
+        return false;
+    }
+    
+    memset(sa, 0, sizeof(sockaddr_in));
+    return AddressAttribute::parse(&value, sa);
+}
+
+bool ParsedMessage::mappedAddress(sockaddr_in* sa) const
+{
+    return address(AT_MAPPED_ADDRESS, sa);
+}
+
+bool ParsedMessage::sourceAddress(sockaddr_in* sa) const
+{
+    return address(AT_SOURCE_ADDRESS, sa);
+}
+
+bool ParsedMessage::changedAddress(sockaddr_in* sa) const
+{
+    return address(AT_CHANGED_ADDRESS, sa);
+}
+
+bool ParsedMessage::reflectedFrom(sockaddr_in* sa) const
+{
+    return address(AT_REFLECTED_FROM, sa);
+}
+
+bool ParsedMessage::responseAddress(sockaddr_in* sa) const
+{
+    return address(AT_RESPONSE_ADDRESS, sa);
+}
+
+bool ParsedMessage::changeRequest(bool* port, bool* ip) const
+{
+    network::BufferView value;
+    if(!findAttribute(AT_CHANGE_REQUEST, &value))
+    {
+        return false;
+    }
+    
+    return ChangeRequestAttribute::parse(&value, port, ip);
+}
+
+bool ParsedMessage::xorMappedAddress(sockaddr_storage* sa) const
+{
+    network::BufferView value;
+    if(!findAttribute(AT_XOR_MAPPED_ADDRESS, &value))
+    {
+        return false;
+    }
+    
+    return XorAddressAttribute::parse(&value, _data + 4, sa);
+}
+
+bool ParsedMessage::errorCode(int* code, network::StringView* reason) const
+{
+    network::BufferView value;
+    if(!findAttribute(AT_ERROR_CODE, &value))
+    {
+        return false;
+    }
+    
+    return ErrorCodeAttribute::parse(&value, code, reason);
+}
+
+size_t ParsedMessage::unknownAttributes(unsigned short* types, size_t n) const
+{
+    network::BufferView value;
+    if(!findAttribute(AT_UNKNOWN_ATTRIBUTES, &value))
+    {
+        return 0;
+    }
+    
+    return UnknownAttributesAttribute::parse(&value, types, n);
+}
+
+bool ParsedMessage::checkIntegrity(const Credential& credential) const
+{
+    for(size_t i = 0; i < _count; ++i)
+    {
+        if(_entries[i].type == AT_MESSAGE_INTEGRITY)
+        {
+            return Message::checkIntegrity(_data, _entries[i].offset + _entries[i].length, credential);
+        }
+    }
+    return false;
+}
+
+STUN_END
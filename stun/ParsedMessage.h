@@ -0,0 +1,116 @@
+//
+//  ParsedMessage.h
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef STUN_PARSED_MESSAGE_H
+#define STUN_PARSED_MESSAGE_H
+
+#include <stun/Config.h>
+#include <stun/Message.h>
+
+STUN_BEGIN
+
+/*
+ Flat representation of a received message
+ 
+ The datagram is not copied, parse() only validates the header and
+ records type, offset and length of each attribute. Values are decoded
+ when an accessor asks for them. No heap, no virtual call, so it can
+ live on the stack of a receive loop:
+ 
+ ParsedMessage msg;
+ if(msg.parse(buf.read(), buf.readable()) && msg.type() == MT_BINDING_RESPONSE)
+ {
+     sockaddr_in sa;
+     msg.mappedAddress(&sa);
+ }
+ 
+ The datagram must outlive the parsed message.
+ */
+
+#define MAX_PARSED_ATTRIBUTES 16
+
+class ParsedMessage
+{
+public:
+    ParsedMessage();
+    ~ParsedMessage();
+    
+    // Index the message at b, false if truncated, malformed or
+    // with more than MAX_PARSED_ATTRIBUTES attributes
+    bool parse(const unsigned char* b, size_t n);
+    bool parse(const network::BufferView& buf);
+    
+    // Last parse() succeeded
+    bool valid() const
+    {
+        return _data != NULL;
+    }
+    
+    // Fields of message header
+    unsigned short type() const // Any value on the wire, not only MESSAGE_TYPE
+    {
+        return _type;
+    }
+    
+    network::UUID tid() const // Empty if not valid
+    {
+        return valid() ? network::UUID(_data + 4, 16) : network::UUID();
+    }
+    
+    // Memory length of message, header included
+    size_t size() const
+    {
+        return _size;
+    }
+    
+    // Number of attributes
+    size_t count() const
+    {
+        return _count;
+    }
+    
+    // Raw value of first attribute of type, false if not present
+    bool findAttribute(ATTRIBUTE_TYPE type, network::BufferView* value) const;
+    
+    // Attributes decoded on demand, false if not present or malformed
+    bool mappedAddress(sockaddr_in* sa) const;
+    bool sourceAddress(sockaddr_in* sa) const;
+    bool changedAddress(sockaddr_in* sa) const;
+    bool reflectedFrom(sockaddr_in* sa) const;
+    bool responseAddress(sockaddr_in* sa) const;
+    bool changeRequest(bool* port, bool* ip) const;
+    bool xorMappedAddress(sockaddr_storage* sa) const;
+    
+    // ERROR-CODE, reason refers to the datagram
+    bool errorCode(int* code, network::StringView* reason) const;
+    
+    // Up to n types of UNKNOWN-ATTRIBUTES, returns number of types
+    size_t unknownAttributes(unsigned short* types, size_t n) const;
+    
+    // Check MESSAGE-INTEGRITY with credential, false if not present
+    bool checkIntegrity(const Credential& credential) const;
+    
+private:
+    struct Entry
+    {
+        unsigned short type;
+        unsigned short offset; // Offset of value from begin of message
+        unsigned short length; // Memory length of value
+    };
+    
+    const unsigned char* _data;
+    size_t _size;
+    unsigned short _type;
+    Entry _entries[MAX_PARSED_ATTRIBUTES];
+    size_t _count;
+    
+    bool address(ATTRIBUTE_TYPE type, sockaddr_in* sa) const;
+};
+
+STUN_END
+
+#endif
@@ -0,0 +1,211 @@
+//
+//  Random.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "Random.h"
+#include "ByteOrder.h"
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#   include <bcrypt.h>
+#   pragma comment(lib, "bcrypt.lib")
+#else
+#   include <pthread.h>
+#   include <sys/syscall.h>
+#endif
+
+NETWORK_BEGIN
+
+//
+// Fill b with n bytes of system entropy
+//
+
+#if defined(_WIN32)
+
+static bool systemRandom(unsigned char* b, size_t n)
+{
+    return BCryptGenRandom(NULL, b, static_cast<ULONG>(n), BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+}
+
+#else
+
+static bool systemRandom(unsigned char* b, size_t n)
+{
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+    arc4random_buf(b, n);
+    return true;
+#else
+#   if defined(__linux) && defined(SYS_getrandom)
+    long rs = ::syscall(SYS_getrandom, b, n, 0);
+    if(rs == static_cast<long>(n))
+    {
+        return true;
+    }
+#   endif
+    // Old kernel, read the device
+    int fd = ::open("/dev/urandom", O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    size_t count = 0;
+    while(count < n)
+    {
+        ssize_t len = ::read(fd, b + count, n - count);
+        if(len <= 0 && errno != EINTR)
+        {
+            break;
+        }
+        count += len > 0 ? len : 0;
+    }
+    ::close(fd);
+    return count == n;
+#endif
+}
+
+#endif
+
+//
+// Count forks, so a child does not repeat the keystream of its parent
+//
+
+static volatile unsigned int forkGeneration = 0;
+
+#if !defined(_WIN32)
+static void forked()
+{
+    forkGeneration = forkGeneration + 1;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+//
+// ChaCha20 block function (RFC 8439)
+// 20 rounds over the key, a 64 bits counter and a zero nonce
+//
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = ROTL32(d, 16); \
+    c += d; b ^= c; b = ROTL32(b, 12); \
+    a += b; d ^= a; d = ROTL32(d, 8); \
+    c += d; b ^= c; b = ROTL32(b, 7);
+
+static void chacha20(const uint32_t* key, uint64_t counter, unsigned char* out)
+{
+    uint32_t input[16] =
+    {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, // "expand 32-byte k"
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), 0, 0
+    };
+    
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+    for(int i = 0; i < 10; ++i)
+    {
+        QUARTER_ROUND(x[0], x[4], x[8],  x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9],  x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8],  x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9],  x[14]);
+    }
+    
+    for(int i = 0; i < 16; ++i)
+    {
+        uint32_t v = x[i] + input[i];
+        out[i * 4] = v & 0xff;
+        out[i * 4 + 1] = (v >> 8) & 0xff;
+        out[i * 4 + 2] = (v >> 16) & 0xff;
+        out[i * 4 + 3] = v >> 24;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Random::Random()
+{
+    seed();
+}
+
+Random::~Random()
+{
+    memset(_key, 0, sizeof(_key));
+    memset(_block, 0, sizeof(_block));
+}
+
+Random& Random::local()
+{
+#if !defined(_WIN32)
+    static int registered = pthread_atfork(NULL, NULL, forked);
+    (void)registered;
+#endif
+    static thread_local Random random;
+    return random;
+}
+
+void Random::seed()
+{
+    if(!systemRandom(reinterpret_cast<unsigned char*>(_key), sizeof(_key)))
+    {
+        throw std::runtime_error("No system entropy");
+    }
+    _generation = forkGeneration;
+    refill();
+}
+
+// Generate a block, first 32 bytes of it are the next key
+void Random::refill()
+{
+    for(size_t i = 0; i < RANDOM_BLOCK_SIZE / 64; ++i)
+    {
+        chacha20(_key, i, _block + i * 64);
+    }
+    memcpy(_key, _block, sizeof(_key));
+    memset(_block, 0, sizeof(_key));
+    _used = sizeof(_key);
+}
+
+void Random::bytes(unsigned char* b, size_t n)
+{
+    if(_generation != forkGeneration)
+    {
+        seed();
+    }
+    
+    while(n > 0)
+    {
+        if(_used == RANDOM_BLOCK_SIZE)
+        {
+            refill();
+        }
+        
+        // Served bytes are wiped
+        size_t k = std::min(n, RANDOM_BLOCK_SIZE - _used);
+        memcpy(b, _block + _used, k);
+        memset(_block + _used, 0, k);
+        _used += k;
+        b += k;
+        n -= k;
+    }
+}
+
+uint64_t Random::next64()
+{
+    unsigned char b[8];
+    bytes(b, sizeof(b));
+    return loadBE64(b);
+}
+
+NETWORK_END
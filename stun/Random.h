@@ -0,0 +1,59 @@
+//
+//  Random.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_RANDOM_H
+#define NETWORK_RANDOM_H
+
+#include "Network.h"
+#include <stdint.h>
+#include <cstddef>
+
+NETWORK_BEGIN
+
+//
+// Cryptographically secure random bytes from a ChaCha20 keystream
+// Seeded once from the system, then no system call per request
+// A block of keystream is generated ahead and served in pieces, and
+// the key is replaced by the first 32 bytes of each block, so bytes
+// already served can not be recovered from the state
+// Not thread safe, use one generator per thread, see local()
+//
+// unsigned char tid[12];
+// network::Random::local().bytes(tid, sizeof(tid));
+//
+
+#define RANDOM_BLOCK_SIZE 512
+
+class Random
+{
+public:
+    Random();
+    ~Random();
+    
+    void bytes(unsigned char* b, size_t n);
+    uint64_t next64();
+    
+    // Generator of the calling thread
+    // Reseeded in the child after fork()
+    static Random& local();
+    
+private:
+    uint32_t _key[8];
+    unsigned char _block[RANDOM_BLOCK_SIZE];
+    size_t _used; // Bytes of block served
+    unsigned int _generation; // Fork generation of seed
+    
+    void seed();
+    void refill();
+    
+    Random(const Random&);
+    Random& operator=(const Random&);
+};
+
+NETWORK_END
+
+#endif
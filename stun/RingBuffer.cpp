@@ -0,0 +1,106 @@
+//
+//  RingBuffer.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "RingBuffer.h"
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#endif
+
+NETWORK_BEGIN
+
+#if !defined(_WIN32)
+
+// Anonymous file to back the ring
+static int openRingFile()
+{
+#if defined(__linux) && defined(SYS_memfd_create)
+    int fd = static_cast<int>(::syscall(SYS_memfd_create, "ring", 0));
+    if(fd >= 0)
+    {
+        return fd;
+    }
+#endif
+    char path[] = "/tmp/ring.XXXXXX";
+    int fd2 = ::mkstemp(path);
+    if(fd2 >= 0)
+    {
+        ::unlink(path);
+    }
+    return fd2;
+}
+
+// Map n bytes twice into 2 * n bytes of address space
+// n must be a multiple of page size
+static unsigned char* mapRing(size_t n)
+{
+    int fd = openRingFile();
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    
+    if(::ftruncate(fd, static_cast<off_t>(n)) != 0)
+    {
+        ::close(fd);
+        return NULL;
+    }
+    
+    // Reserve address space, then map the file over both halves
+    void* p = ::mmap(NULL, 2 * n, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if(p == MAP_FAILED)
+    {
+        ::close(fd);
+        return NULL;
+    }
+    
+    unsigned char* base = static_cast<unsigned char*>(p);
+    if(::mmap(base, n, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+       ::mmap(base + n, n, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        ::munmap(base, 2 * n);
+        ::close(fd);
+        return NULL;
+    }
+    
+    ::close(fd); // Mappings keep the file
+    return base;
+}
+
+#endif
+
+RingBuffer::RingBuffer(size_t capacity)
+: Buffer(capacity)
+, _mirror(NULL)
+, _length(0)
+{
+    assert(capacity > 0);
+#if !defined(_WIN32)
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t length = (capacity + page - 1) / page * page;
+    _mirror = mapRing(length);
+    if(_mirror != NULL)
+    {
+        _length = length;
+        attach(_mirror, _length, true);
+    }
+#endif
+}
+
+RingBuffer::~RingBuffer()
+{
+#if !defined(_WIN32)
+    if(_mirror != NULL)
+    {
+        ::munmap(_mirror, 2 * _length);
+    }
+#endif
+}
+
+NETWORK_END
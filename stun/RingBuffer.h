@@ -0,0 +1,52 @@
+//
+//  RingBuffer.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_RING_BUFFER_H
+#define NETWORK_RING_BUFFER_H
+
+#include "Buffer.h"
+
+NETWORK_BEGIN
+
+//
+// Buffer of fixed capacity for stream I/O
+// Memory is mapped twice back to back (a "magic ring"), so readable
+// bytes are always contiguous and reading never moves data
+// If the system can't map the memory twice, falls back to a buffer
+// limited to the capacity, which moves unread bytes to front on reserve
+//
+// Same API as Buffer, but reserve() never grows the buffer:
+//
+// network::RingBuffer buf(64 * 1024);
+// buf.receive(fd); // At most writable() bytes
+// while(parse(buf.read(), buf.readable())) ...
+//
+
+class RingBuffer : public Buffer
+{
+public:
+    RingBuffer(size_t capacity = 64 * 1024); // Rounded up to page size if mapped
+    ~RingBuffer();
+
+    // Memory is mapped twice
+    bool mirrored() const
+    {
+        return _mirror != NULL;
+    }
+
+private:
+    unsigned char* _mirror; // Mapped memory of 2 * _length bytes
+    size_t _length;
+
+    // Ring can't be copied, as the base Buffer could
+    RingBuffer(const RingBuffer&);
+    RingBuffer& operator=(const RingBuffer&);
+};
+
+NETWORK_END
+
+#endif
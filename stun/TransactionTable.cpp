@@ -0,0 +1,180 @@
+//
+//  TransactionTable.cpp
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "TransactionTable.h"
+#include <chrono>
+#include <cstring>
+#include <cassert>
+
+STUN_BEGIN
+
+TransactionTable::TransactionTable(size_t capacity)
+: _slots(NULL)
+, _memory(NULL)
+, _mask(0)
+, _shift(64)
+, _size(0)
+{
+    size_t n = 8;
+    while(n < capacity)
+    {
+        n <<= 1;
+    }
+    allocate(n);
+}
+
+TransactionTable::~TransactionTable()
+{
+    delete[] _memory;
+}
+
+int64_t TransactionTable::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Fold the two words of ID, the bits are random already
+// 0 marks a free slot, so it is not a key
+uint64_t TransactionTable::fold(const unsigned char* tid)
+{
+    uint64_t w[2];
+    memcpy(w, tid, sizeof(w));
+    uint64_t key = w[0] ^ w[1];
+    return key != 0 ? key : 1;
+}
+
+// Empty table of n slots, n is power of 2
+void TransactionTable::allocate(size_t n)
+{
+    _memory = new unsigned char[n * sizeof(Transaction) + alignof(Transaction)];
+    uintptr_t p = reinterpret_cast<uintptr_t>(_memory);
+    p = (p + alignof(Transaction) - 1) & ~static_cast<uintptr_t>(alignof(Transaction) - 1);
+    _slots = reinterpret_cast<Transaction*>(p);
+    memset(_slots, 0, n * sizeof(Transaction));
+    
+    _mask = n - 1;
+    _shift = 64;
+    for(size_t i = n; i > 1; i >>= 1)
+    {
+        --_shift;
+    }
+    _size = 0;
+}
+
+// Double the slots and reinsert
+void TransactionTable::grow()
+{
+    Transaction* slots = _slots;
+    unsigned char* memory = _memory;
+    size_t n = _mask + 1;
+    allocate(n * 2);
+    
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(slots[i].key == 0)
+        {
+            continue;
+        }
+        size_t j = home(slots[i].key);
+        while(_slots[j].key != 0)
+        {
+            j = (j + 1) & _mask;
+        }
+        _slots[j] = slots[i];
+        ++_size;
+    }
+    delete[] memory;
+}
+
+Transaction* TransactionTable::insert(const network::UUID& tid, void* context)
+{
+    // No more than half full, so probes stay short
+    if((_size + 1) * 2 > _mask + 1)
+    {
+        grow();
+    }
+    
+    uint64_t key = fold(tid.bytes());
+    size_t i = home(key);
+    while(_slots[i].key != 0)
+    {
+        if(_slots[i].key == key && memcmp(_slots[i].tid, tid.bytes(), 16) == 0)
+        {
+            return NULL;
+        }
+        i = (i + 1) & _mask;
+    }
+    
+    Transaction* t = &_slots[i];
+    memset(t, 0, sizeof(Transaction));
+    t->key = key;
+    memcpy(t->tid, tid.bytes(), 16);
+    t->context = context;
+    ++_size;
+    return t;
+}
+
+Transaction* TransactionTable::find(const unsigned char* tid) const
+{
+    uint64_t key = fold(tid);
+    size_t i = home(key);
+    while(_slots[i].key != 0)
+    {
+        if(_slots[i].key == key && memcmp(_slots[i].tid, tid, 16) == 0)
+        {
+            return &_slots[i];
+        }
+        i = (i + 1) & _mask;
+    }
+    return NULL;
+}
+
+bool TransactionTable::remove(const network::UUID& tid)
+{
+    Transaction* t = find(tid);
+    if(t == NULL)
+    {
+        return false;
+    }
+    remove(t);
+    return true;
+}
+
+// Shift following entries of the probe chain back into the hole,
+// unless the hole is before their home slot
+void TransactionTable::remove(Transaction* t)
+{
+    assert(t >= _slots && t <= _slots + _mask && t->key != 0);
+    size_t i = t - _slots;
+    size_t j = i;
+    for(;;)
+    {
+        j = (j + 1) & _mask;
+        if(_slots[j].key == 0)
+        {
+            break;
+        }
+        size_t k = home(_slots[j].key);
+        if(((j - k) & _mask) < ((j - i) & _mask))
+        {
+            continue;
+        }
+        _slots[i] = _slots[j];
+        i = j;
+    }
+    _slots[i].key = 0;
+    --_size;
+}
+
+void TransactionTable::clear()
+{
+    memset(_slots, 0, (_mask + 1) * sizeof(Transaction));
+    _size = 0;
+}
+
+STUN_END
@@ -0,0 +1,121 @@
+//
+//  TransactionTable.h
+//  stun
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef STUN_TRANSACTION_TABLE_H
+#define STUN_TRANSACTION_TABLE_H
+
+#include <stun/Config.h>
+#include <stun/UUID.h>
+#include <stdint.h>
+
+STUN_BEGIN
+
+/*
+ Outstanding transactions of a socket, keyed by transaction ID
+ 
+ Open addressing with linear probing over the transaction ID folded to
+ 64 bits, a cache line per slot, so a lookup is mostly one cache miss.
+ The table doubles when half full, and removal shifts entries back
+ rather than leaving tombstones, so lookups stay O(1) with tens of
+ thousands of transactions in flight.
+ 
+ Pointers to transactions are only valid until the next insert() or
+ remove().
+ 
+ stun::Transaction* t = table.insert(request.tid());
+ socket.write(request.data(), request.size());
+ ...
+ stun::Transaction* t = table.find(datagram + 4); // Transaction ID
+ if(t != NULL)
+ {
+     rtt = stun::TransactionTable::now() - t->sent;
+     table.remove(t);
+ }
+ */
+
+struct alignas(64) Transaction
+{
+    uint64_t key; // Folded transaction ID, 0 if slot is free
+    unsigned char tid[16];
+    int64_t sent; // First sent, microseconds
+    int64_t resent; // Last sent, microseconds
+    void* context;
+    unsigned int retransmits;
+    
+    // Record a send at the time
+    void send(int64_t time)
+    {
+        if(resent == 0)
+        {
+            sent = time;
+        }
+        else
+        {
+            ++retransmits;
+        }
+        resent = time;
+    }
+};
+
+class TransactionTable
+{
+public:
+    TransactionTable(size_t capacity = 64); // Initial number of slots
+    ~TransactionTable();
+    
+    // New transaction, NULL if the ID is in the table already
+    Transaction* insert(const network::UUID& tid, void* context = NULL);
+    
+    // Transaction of the ID, NULL if none
+    // The raw form takes the 16 bytes at offset 4 of a message
+    Transaction* find(const unsigned char* tid) const;
+    Transaction* find(const network::UUID& tid) const
+    {
+        return find(tid.bytes());
+    }
+    
+    bool remove(const network::UUID& tid);
+    void remove(Transaction* t);
+    void clear();
+    
+    size_t size() const
+    {
+        return _size;
+    }
+    
+    size_t capacity() const
+    {
+        return _mask + 1;
+    }
+    
+    // Monotonic clock for send timestamps, microseconds
+    static int64_t now();
+    
+private:
+    Transaction* _slots;
+    unsigned char* _memory; // Allocated memory, _slots aligned in it
+    size_t _mask; // Number of slots - 1
+    unsigned int _shift; // 64 - log2 of number of slots
+    size_t _size;
+    
+    static uint64_t fold(const unsigned char* tid);
+    
+    size_t home(uint64_t key) const
+    {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> _shift);
+    }
+    
+    void allocate(size_t capacity);
+    void grow();
+    
+    TransactionTable(const TransactionTable&);
+    TransactionTable& operator=(const TransactionTable&);
+};
+
+STUN_END
+
+#endif
@@ -11,6 +11,9 @@
 
 #include "Network.h"
 #include <string>
+#include <cstring>
+#include <cassert>
+#include <stdint.h>
 
 #if defined(_WIN32)
 #   include <Rpc.h>
@@ -23,6 +26,7 @@ NETWORK_BEGIN
 
 //
 // UUID is a 128 bit identifier.
+// Compared and hashed as two 64 bits words
 //
 
 #if defined(_WIN32)
@@ -33,7 +37,7 @@ struct UUID
     
     UUID()
     {
-        
+        memset(&data, 0, sizeof(uuid_t));
     }
     
     UUID(const unsigned char* b, size_t n)
@@ -68,7 +72,7 @@ struct UUID
     
     const unsigned char* bytes() const
     {
-		return reinterpret_cast<unsigned char*>(&data);
+		return reinterpret_cast<const unsigned char*>(&data);
     }
     
     size_t size() const
@@ -76,16 +80,29 @@ struct UUID
         return sizeof(uuid_t);
     }
     
-    bool operator==(const UUID &other)
+    bool operator==(const UUID &other) const
     {
-		RPC_STATUS rs;
-		return UuidCompare(&data, const_cast<uuid_t*>(&other.data), &rs) == 0;
+        return word(0) == other.word(0) && word(1) == other.word(1);
     }
     
-    bool operator!=(const UUID &other)
+    bool operator!=(const UUID &other) const
     {
-		RPC_STATUS rs;
-		return UuidCompare(&data, const_cast<uuid_t*>(&other.data), &rs) != 0;
+        return !(*this == other);
+    }
+    
+    // Fold of the two words, the bits are random already
+    size_t hash() const
+    {
+        uint64_t h = word(0) ^ (word(1) * 0x9E3779B97F4A7C15ULL);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+    
+    // i-th 64 bits word of the identifier, in memory order
+    uint64_t word(size_t i) const
+    {
+        uint64_t v;
+        memcpy(&v, bytes() + i * sizeof(v), sizeof(v));
+        return v;
     }
     
     std::string toString() const
@@ -146,14 +163,29 @@ struct UUID
         return sizeof(uuid_t);
     }
     
-    bool operator==(const UUID &other)
+    bool operator==(const UUID &other) const
+    {
+        return word(0) == other.word(0) && word(1) == other.word(1);
+    }
+    
+    bool operator!=(const UUID &other) const
     {
-        return uuid_compare(data, other.data) == 0;
+        return !(*this == other);
     }
     
-    bool operator!=(const UUID &other)
+    // Fold of the two words, the bits are random already
+    size_t hash() const
     {
-        return uuid_compare(data, other.data) != 0;
+        uint64_t h = word(0) ^ (word(1) * 0x9E3779B97F4A7C15ULL);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+    
+    // i-th 64 bits word of the identifier, in memory order
+    uint64_t word(size_t i) const
+    {
+        uint64_t v;
+        memcpy(&v, bytes() + i * sizeof(v), sizeof(v));
+        return v;
     }
     
     std::string toString() const
@@ -166,6 +198,16 @@ struct UUID
 
 #endif
 
+// For unordered containers
+// std::unordered_map<network::UUID, Transaction*, network::UUIDHash>
+struct UUIDHash
+{
+    size_t operator()(const UUID& id) const
+    {
+        return id.hash();
+    }
+};
+
 NETWORK_END
 
 #endif
@@ -0,0 +1,730 @@
+//
+//  UringSocket.cpp
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#include "UringSocket.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux)
+#   include <sys/syscall.h>
+#   include <sys/mman.h>
+#   include <sys/eventfd.h>
+#endif
+
+// Multishot recvmsg and provided buffer rings came with Linux 6.0,
+// with older headers only the fallback is built
+#if defined(__linux) && defined(SYS_io_uring_setup)
+#   include <linux/io_uring.h>
+#   if defined(IORING_RECV_MULTISHOT)
+#       define URING_SUPPORTED
+#   endif
+#endif
+
+NETWORK_BEGIN
+
+#if defined(URING_SUPPORTED)
+
+#define URING_ENTRIES 256 // Submission queue
+#define URING_BUFFERS 256 // Provided receive buffers, power of 2
+#define URING_BUFFER_SIZE (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + MAX_DATAGRAM_SIZE)
+#define URING_BUFFER_GROUP 0
+
+// user_data of requests
+#define URING_RECEIVE 1
+#define URING_SEND 2
+
+struct UringSocket::Ring
+{
+    int fd;
+    int event; // Readable while datagrams are queued, see sync()
+    SOCKET socket;
+    bool watched; // fd() was handed out
+    bool eventClear; // Read with no completion posted since, eventTail
+    unsigned eventTail;
+
+    // Submission queue
+    unsigned char* sq;
+    size_t sqSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    struct io_uring_sqe* sqes;
+    unsigned unsubmitted;
+
+    // Completion queue, mapped with submission queue if cq == sq
+    unsigned char* cq;
+    size_t cqSize;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    // Receive buffers provided to kernel
+    struct io_uring_buf_ring* buffers;
+    unsigned char* memory; // URING_BUFFERS buffers of URING_BUFFER_SIZE bytes
+    unsigned short bufferTail;
+
+    // Multishot receive, stays armed until the kernel ends it
+    struct msghdr receiveHeader;
+    bool armed;
+    bool failed; // Multishot recvmsg not supported
+
+    // Received datagrams not read yet, as (length, buffer id)
+    unsigned pending[URING_BUFFERS][2];
+    size_t pendingHead;
+    size_t pendingCount;
+
+    // Sends in flight
+    struct msghdr sendHeaders[URING_ENTRIES];
+    struct iovec sendVectors[URING_ENTRIES];
+    unsigned sending;
+    unsigned sent;
+
+    Ring();
+    ~Ring();
+
+    bool open(SOCKET s);
+    struct io_uring_sqe* next();
+    int enter(unsigned complete, int timeout);
+    bool arm();
+    void reap();
+    bool take(unsigned* length, unsigned* id);
+    void recycle(unsigned id);
+    void sync();
+
+    const unsigned char* buffer(unsigned id) const
+    {
+        return memory + id * URING_BUFFER_SIZE;
+    }
+};
+
+static int uringSetup(unsigned entries, struct io_uring_params* p)
+{
+    return static_cast<int>(::syscall(SYS_io_uring_setup, entries, p));
+}
+
+static int uringEnter(int fd, unsigned submit, unsigned complete, unsigned flags, void* arg, size_t size)
+{
+    return static_cast<int>(::syscall(SYS_io_uring_enter, fd, submit, complete, flags, arg, size));
+}
+
+static int uringRegister(int fd, unsigned op, void* arg, unsigned n)
+{
+    return static_cast<int>(::syscall(SYS_io_uring_register, fd, op, arg, n));
+}
+
+UringSocket::Ring::Ring()
+: fd(-1)
+, event(-1)
+, socket(INVALID_SOCKET)
+, watched(false)
+, eventClear(false)
+, eventTail(0)
+, sq(NULL)
+, sqes(NULL)
+, unsubmitted(0)
+, cq(NULL)
+, buffers(NULL)
+, memory(NULL)
+, bufferTail(0)
+, armed(false)
+, failed(false)
+, pendingHead(0)
+, pendingCount(0)
+, sending(0)
+, sent(0)
+{
+
+}
+
+UringSocket::Ring::~Ring()
+{
+    if(fd >= 0)
+    {
+        ::close(fd);
+    }
+    if(event >= 0)
+    {
+        ::close(event);
+    }
+    if(sqes != NULL)
+    {
+        ::munmap(sqes, sqEntries * sizeof(struct io_uring_sqe));
+    }
+    if(cq != NULL && cq != sq)
+    {
+        ::munmap(cq, cqSize);
+    }
+    if(sq != NULL)
+    {
+        ::munmap(sq, sqSize);
+    }
+    if(buffers != NULL)
+    {
+        ::munmap(buffers, URING_BUFFERS * sizeof(struct io_uring_buf));
+    }
+    delete[] memory;
+}
+
+// Map queues, provide receive buffers and arm the receive on socket s,
+// false if not supported
+bool UringSocket::Ring::open(SOCKET s)
+{
+    if(s == INVALID_SOCKET)
+    {
+        return false;
+    }
+    socket = s;
+    
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd = uringSetup(URING_ENTRIES, &p);
+    if(fd < 0 || !(p.features & IORING_FEAT_EXT_ARG))
+    {
+        return false;
+    }
+
+    sqEntries = p.sq_entries;
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sqSize = cqSize = std::max(sqSize, cqSize);
+    }
+
+    void* m = ::mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(m == MAP_FAILED)
+    {
+        return false;
+    }
+    sq = static_cast<unsigned char*>(m);
+
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        cq = sq;
+    }
+    else
+    {
+        m = ::mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(m == MAP_FAILED)
+        {
+            return false;
+        }
+        cq = static_cast<unsigned char*>(m);
+    }
+
+    m = ::mmap(NULL, sqEntries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(m == MAP_FAILED)
+    {
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe*>(m);
+
+    sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    // Ring of buffers must be page aligned
+    m = ::mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(m == MAP_FAILED)
+    {
+        return false;
+    }
+    buffers = static_cast<struct io_uring_buf_ring*>(m);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uintptr_t>(buffers);
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if(uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        return false;
+    }
+
+    memory = new unsigned char[URING_BUFFERS * URING_BUFFER_SIZE];
+    for(unsigned i = 0; i < URING_BUFFERS; ++i)
+    {
+        recycle(i);
+    }
+
+    // Kernel signals eventfd on each completion
+    event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(event < 0 || uringRegister(fd, IORING_REGISTER_EVENTFD, &event, 1) < 0)
+    {
+        return false;
+    }
+
+    // Only the source address, no control data
+    memset(&receiveHeader, 0, sizeof(receiveHeader));
+    receiveHeader.msg_namelen = sizeof(struct sockaddr_in);
+
+    // Receive from now on, so the socket can be watched before any read
+    arm();
+    return enter(0, 0) >= 0;
+}
+
+// Free entry of submission queue, published and submitted by next enter()
+struct io_uring_sqe* UringSocket::Ring::next()
+{
+    unsigned tail = *sqTail + unsubmitted;
+    if(tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+    {
+        return NULL;
+    }
+
+    struct io_uring_sqe* sqe = &sqes[tail & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[tail & sqMask] = tail & sqMask;
+    ++unsubmitted;
+    return sqe;
+}
+
+// Submit queued requests and wait for complete completions,
+// up to timeout (ms, -1 for ever), returns -errno if failed
+int UringSocket::Ring::enter(unsigned complete, int timeout)
+{
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if(timeout >= 0)
+    {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uintptr_t>(&ts);
+    }
+
+    // Entries are filled, publish them
+    // Entries left by a failed enter are submitted again
+    unsigned tail = *sqTail + unsubmitted;
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+    unsubmitted = 0;
+    unsigned submit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    unsigned flags = IORING_ENTER_EXT_ARG | (complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+    int rc = uringEnter(fd, submit, complete, flags, &arg, sizeof(arg));
+    return rc < 0 ? -errno : rc;
+}
+
+// Queue the multishot receive if the kernel ended it,
+// true if queued and to be submitted
+bool UringSocket::Ring::arm()
+{
+    if(armed || failed)
+    {
+        return false;
+    }
+
+    struct io_uring_sqe* sqe = next();
+    if(sqe == NULL)
+    {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket;
+    sqe->addr = reinterpret_cast<uintptr_t>(&receiveHeader);
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_RECEIVE;
+    armed = true;
+    return true;
+}
+
+// Drain completion queue, received datagrams are queued in pending
+// and completed sends counted
+void UringSocket::Ring::reap()
+{
+    unsigned head = *cqHead;
+    while(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+
+        if(cqe.user_data == URING_SEND)
+        {
+            --sending;
+            sent += cqe.res >= 0 ? 1 : 0;
+            continue;
+        }
+
+        if(!(cqe.flags & IORING_CQE_F_MORE))
+        {
+            armed = false;
+        }
+        if(cqe.res < 0)
+        {
+            // Out of buffers ends the receive, rearmed when buffers are back
+            failed = failed || cqe.res == -EINVAL;
+            continue;
+        }
+
+        // A buffer is in pending once, so there is always room
+        size_t tail = (pendingHead + pendingCount) % URING_BUFFERS;
+        pending[tail][0] = cqe.res;
+        pending[tail][1] = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        ++pendingCount;
+    }
+}
+
+// Next received datagram as (bytes in buffer, buffer id), false if none
+bool UringSocket::Ring::take(unsigned* length, unsigned* id)
+{
+    if(pendingCount == 0)
+    {
+        reap();
+        if(pendingCount == 0)
+        {
+            return false;
+        }
+    }
+
+    *length = pending[pendingHead][0];
+    *id = pending[pendingHead][1];
+    pendingHead = (pendingHead + 1) % URING_BUFFERS;
+    --pendingCount;
+    return true;
+}
+
+// Give buffer back to kernel
+void UringSocket::Ring::recycle(unsigned id)
+{
+    // Not buffers->bufs, its empty struct in front takes a byte in C++
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(buffers) + (bufferTail & (URING_BUFFERS - 1));
+    buf->addr = reinterpret_cast<uintptr_t>(buffer(id));
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = static_cast<unsigned short>(id);
+    __atomic_store_n(&buffers->tail, ++bufferTail, __ATOMIC_RELEASE);
+}
+
+// After datagrams are taken, rearm a receive that ended once buffers
+// are back, and keep eventfd readable while datagrams are queued
+// Kernel signals eventfd on each completion, and it is only reset here
+// when the queue runs empty, so it stays readable from the completion
+// that queued a datagram until the datagram is taken. Nothing to do
+// while the queue holds datagrams, or if no completion was posted since
+// the last reset, or if fd() was never handed out
+void UringSocket::Ring::sync()
+{
+    if(!armed && !failed && pendingCount < URING_BUFFERS && arm())
+    {
+        enter(0, 0);
+    }
+
+    if(pendingCount > 0 || !watched)
+    {
+        return;
+    }
+    if(eventClear && eventTail == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    // A completion posted before the reset is reaped after it,
+    // signal it again
+    uint64_t count;
+    ssize_t rc = ::read(event, &count, sizeof(count));
+    reap();
+    eventClear = pendingCount == 0;
+    eventTail = *cqHead;
+    if(pendingCount > 0)
+    {
+        count = 1;
+        rc = ::write(event, &count, sizeof(count));
+    }
+    (void)rc;
+}
+
+// Payload and source address of datagram in buffer
+static const unsigned char* payload(const unsigned char* buf, unsigned length, const struct msghdr& header,
+                                    size_t* size, struct sockaddr_in* from)
+{
+    struct io_uring_recvmsg_out out;
+    memcpy(&out, buf, sizeof(out));
+    const unsigned char* name = buf + sizeof(out);
+    const unsigned char* data = name + header.msg_namelen + header.msg_controllen;
+    if(from != NULL)
+    {
+        memset(from, 0, sizeof(*from));
+        memcpy(from, name, std::min(static_cast<size_t>(out.namelen), sizeof(*from)));
+    }
+    *size = std::min(static_cast<size_t>(out.payloadlen), static_cast<size_t>(buf + length - data));
+    return data;
+}
+
+#else
+
+struct UringSocket::Ring
+{
+    bool failed;
+};
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+
+UringSocket::UringSocket()
+: _ring(NULL)
+{
+#if defined(URING_SUPPORTED)
+    _ring = new Ring();
+    if(!_ring->open(_socket.fd()))
+    {
+        delete _ring;
+        _ring = NULL;
+    }
+#endif
+}
+
+UringSocket::UringSocket(const std::string& host, unsigned short port)
+: _socket(host, port)
+, _ring(NULL)
+{
+#if defined(URING_SUPPORTED)
+    _ring = new Ring();
+    if(!_ring->open(_socket.fd()))
+    {
+        delete _ring;
+        _ring = NULL;
+    }
+#endif
+}
+
+UringSocket::~UringSocket()
+{
+    delete _ring;
+}
+
+bool UringSocket::uring() const
+{
+    return _ring != NULL && !_ring->failed;
+}
+
+SOCKET UringSocket::fd() const
+{
+#if defined(URING_SUPPORTED)
+    if(uring())
+    {
+        _ring->watched = true;
+        return _ring->event;
+    }
+#endif
+    return _socket.fd();
+}
+
+// A single datagram costs one system call either way
+ssize_t UringSocket::write(const unsigned char* buf, size_t size)
+{
+    return _socket.write(buf, size);
+}
+
+// Linked sends, submitted and reaped with one system call per
+// URING_ENTRIES datagrams, a failed send cancels the rest as sendmmsg
+// stops at the first error
+ssize_t UringSocket::write(DatagramBatch* batch)
+{
+    assert(batch != NULL);
+#if defined(URING_SUPPORTED)
+    if(uring())
+    {
+        size_t count = 0;
+        while(count < batch->count())
+        {
+            _ring->sent = 0;
+            size_t n = std::min(batch->count() - count, static_cast<size_t>(URING_ENTRIES - 1));
+            for(size_t i = 0; i < n; ++i)
+            {
+                struct io_uring_sqe* sqe = _ring->next();
+                if(sqe == NULL)
+                {
+                    n = i;
+                    break;
+                }
+
+                size_t k = count + i;
+                struct iovec* iov = &_ring->sendVectors[i];
+                iov->iov_base = const_cast<unsigned char*>(batch->data(k));
+                iov->iov_len = batch->size(k);
+                struct msghdr* msg = &_ring->sendHeaders[i];
+                memset(msg, 0, sizeof(*msg));
+                msg->msg_name = const_cast<struct sockaddr_in*>(&batch->address(k));
+                msg->msg_namelen = sizeof(struct sockaddr_in);
+                msg->msg_iov = iov;
+                msg->msg_iovlen = 1;
+
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = _socket.fd();
+                sqe->addr = reinterpret_cast<uintptr_t>(msg);
+                sqe->len = 1;
+                sqe->flags = i + 1 < n ? IOSQE_IO_LINK : 0;
+                sqe->user_data = URING_SEND;
+                ++_ring->sending;
+            }
+
+            if(n == 0)
+            {
+                break;
+            }
+            
+            // Batch memory must stay until all sends complete
+            _ring->enter(n, -1);
+            for(;;)
+            {
+                _ring->reap();
+                if(_ring->sending == 0)
+                {
+                    break;
+                }
+                int rc = _ring->enter(1, -1);
+                if(rc < 0 && rc != -EINTR)
+                {
+                    break;
+                }
+            }
+
+            count += _ring->sent;
+            if(_ring->sent < n)
+            {
+                break;
+            }
+        }
+        return count > 0 || batch->count() == 0 ? static_cast<ssize_t>(count) : -1;
+    }
+#endif
+    return _socket.write(batch);
+}
+
+ssize_t UringSocket::read(unsigned char* buf, size_t size)
+{
+    return read(buf, size, -1);
+}
+
+ssize_t UringSocket::read(DatagramBatch* batch)
+{
+    return read(batch, -1);
+}
+
+ssize_t UringSocket::read(unsigned char* buf, size_t size, int timeout)
+{
+#if defined(URING_SUPPORTED)
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while(uring())
+    {
+        ssize_t rc = receive(buf, size);
+        if(rc >= 0)
+        {
+            return rc;
+        }
+
+        int wait = timeout;
+        if(timeout >= 0)
+        {
+            wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count());
+            if(wait < 0)
+            {
+                return -1;
+            }
+        }
+
+        _ring->arm();
+        if(_ring->enter(1, wait) < 0)
+        {
+            return receive(buf, size);
+        }
+    }
+#endif
+    return _socket.read(buf, size, timeout);
+}
+
+ssize_t UringSocket::read(DatagramBatch* batch, int timeout)
+{
+    assert(batch != NULL);
+#if defined(URING_SUPPORTED)
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while(uring())
+    {
+        ssize_t rc = receive(batch);
+        if(rc > 0)
+        {
+            return rc;
+        }
+
+        int wait = timeout;
+        if(timeout >= 0)
+        {
+            wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count());
+            if(wait < 0)
+            {
+                return -1;
+            }
+        }
+
+        _ring->arm();
+        if(_ring->enter(1, wait) < 0)
+        {
+            rc = receive(batch);
+            return rc > 0 ? rc : -1;
+        }
+    }
+#endif
+    return _socket.read(batch, timeout);
+}
+
+ssize_t UringSocket::receive(unsigned char* buf, size_t size)
+{
+    ssize_t rc = -1;
+#if defined(URING_SUPPORTED)
+    unsigned length;
+    unsigned id;
+    if(_ring->take(&length, &id))
+    {
+        size_t n;
+        const unsigned char* data = payload(_ring->buffer(id), length, _ring->receiveHeader, &n, NULL);
+        n = std::min(n, size);
+        memcpy(buf, data, n);
+        _ring->recycle(id);
+        rc = static_cast<ssize_t>(n);
+    }
+    _ring->sync();
+#else
+    (void)buf;
+    (void)size;
+#endif
+    return rc;
+}
+
+ssize_t UringSocket::receive(DatagramBatch* batch)
+{
+    batch->clear();
+#if defined(URING_SUPPORTED)
+    unsigned length;
+    unsigned id;
+    while(!batch->full() && _ring->take(&length, &id))
+    {
+        size_t n;
+        struct sockaddr_in from;
+        const unsigned char* data = payload(_ring->buffer(id), length, _ring->receiveHeader, &n, &from);
+        batch->add(data, std::min(n, batch->slotSize()), from);
+        _ring->recycle(id);
+    }
+    _ring->sync();
+#endif
+    return static_cast<ssize_t>(batch->count());
+}
+
+NETWORK_END
@@ -0,0 +1,100 @@
+//
+//  UringSocket.h
+//  network
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef NETWORK_URING_SOCKET_H
+#define NETWORK_URING_SOCKET_H
+
+#include "Network.h"
+#include "DatagramBatch.h"
+
+NETWORK_BEGIN
+
+//
+// UDP socket driven by io_uring, same interface as UdpSocket
+// Datagrams are received by one multishot recvmsg into a ring of buffers
+// provided to the kernel, so receiving takes no system call while
+// completions are queued, and a batch of sends is submitted as linked
+// requests with one system call
+// Falls back to UdpSocket calls if the kernel has no io_uring, or no
+// multishot recvmsg or provided buffer rings (before 6.0)
+// Not thread safe
+//
+// network::UringSocket socket(host, port);
+// socket.write(&requests);
+// while(socket.read(&responses, 200) > 0) ...
+//
+
+class UringSocket
+{
+public:
+    UringSocket();
+    UringSocket(const std::string& host, unsigned short port); // Remote address
+    ~UringSocket();
+    
+    // io_uring is in use
+    bool uring() const;
+    
+    // Descriptor to watch with EventLoop, readable while datagrams are
+    // queued: an eventfd kept in step with the queue if io_uring is in
+    // use, the socket otherwise
+    // Receiving starts at construction, so it can be watched before the
+    // first read, and a read that takes one of several queued datagrams
+    // leaves it readable. It may wake for a completion that holds no
+    // datagram, so read with timeout 0 in a handler
+    SOCKET fd() const;
+    
+    // Plain socket, e.g. for options
+    UdpSocket& socket()
+    {
+        return _socket;
+    }
+    
+    sockaddr_in localAddress()
+    {
+        return _socket.localAddress();
+    }
+    
+    sockaddr_in remoteAddress()
+    {
+        return _socket.remoteAddress();
+    }
+    
+    void setRemoteAddress(const std::string& host, unsigned short port)
+    {
+        _socket.setRemoteAddress(host, port);
+    }
+    
+    void setRemoteAddress(const struct sockaddr_in& sin)
+    {
+        _socket.setRemoteAddress(sin);
+    }
+    
+    ssize_t write(const unsigned char* buf, size_t size);
+    ssize_t write(DatagramBatch* batch);
+    ssize_t read(unsigned char* buf, size_t size);
+    ssize_t read(unsigned char* buf, size_t size, int timeout);
+    ssize_t read(DatagramBatch* batch);
+    ssize_t read(DatagramBatch* batch, int timeout);
+    
+private:
+    UdpSocket _socket;
+    
+    // Queues and buffers shared with the kernel, NULL if not available
+    struct Ring;
+    Ring* _ring;
+    
+    // Take queued datagrams without waiting, -1 if none
+    ssize_t receive(unsigned char* buf, size_t size);
+    ssize_t receive(DatagramBatch* batch);
+    
+    UringSocket(const UringSocket&);
+    UringSocket& operator=(const UringSocket&);
+};
+
+NETWORK_END
+
+#endif
@@ -0,0 +1,40 @@
+//
+//  Check.h
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+//
+// Checks of the standalone test programs
+// A failed check prints its file and line, and the run goes on
+//
+// CHECK(table.size() == 0);
+// ...
+// return checkResult();
+//
+
+static int checkFailures = 0;
+
+#define CHECK(x) \
+    do \
+    { \
+        if(!(x)) \
+        { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": " #x " failed\n"; \
+            ++checkFailures; \
+        } \
+    } while(0)
+
+// Print the outcome, exit code of main()
+static inline int checkResult()
+{
+    std::cout << (checkFailures == 0 ? "ok\n" : "FAILED\n");
+    return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,125 @@
+//
+//  DelimiterBench.cpp
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+//
+// Time of splitting text into lines with DelimiterSet, against the
+// std::find_first_of scan that Buffer::readString() used before
+//
+// g++ -O2 -I. -Istun stun/*.cpp test/DelimiterBench.cpp -o bench && ./bench
+//
+
+#include <stun/Delimiter.h>
+#include <stun/BufferView.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#define BENCH_LINES 2000
+#define BENCH_ROUNDS 200
+
+// Lines of short and long header fields, as in SIP or HTTP text
+static std::string makeText()
+{
+    std::string text;
+    for(size_t i = 0; i < BENCH_LINES; ++i)
+    {
+        text += "Field-" + std::to_string(i) + ": ";
+        text.append(8 + (i * 37) % 300, 'a' + i % 26);
+        text += "\r\n";
+    }
+    return text;
+}
+
+// Lines found and time in ms
+struct Result
+{
+    size_t lines;
+    double ms;
+};
+
+template <typename Split>
+static Result measure(const std::string& text, Split split)
+{
+    Result r = { 0, 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < BENCH_ROUNDS; ++i)
+    {
+        r.lines = split(text);
+    }
+    std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start;
+    r.ms = d.count();
+    return r;
+}
+
+// The scan before DelimiterSet
+static size_t splitFindFirstOf(const std::string& text)
+{
+    const std::string delim("\r\n");
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t lines = 0;
+    while(p < end)
+    {
+        const char* q = std::find_first_of(p, end, delim.begin(), delim.end());
+        if(q == end)
+        {
+            break;
+        }
+        ++lines;
+        p = q + delim.size();
+    }
+    return lines;
+}
+
+// Set built on every call, as readString() with a string does
+static size_t splitString(const std::string& text)
+{
+    network::BufferView view(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    network::StringView line;
+    size_t lines = 0;
+    while(view.readString(line, std::string("\r\n")))
+    {
+        ++lines;
+    }
+    return lines;
+}
+
+// Set built once
+static size_t splitDelimiterSet(const std::string& text)
+{
+    static const network::DelimiterSet delim("\r\n");
+    network::BufferView view(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    network::StringView line;
+    size_t lines = 0;
+    while(view.readString(line, delim))
+    {
+        ++lines;
+    }
+    return lines;
+}
+
+static void report(const char* name, const Result& r, double base)
+{
+    std::cout << name << ": " << r.lines << " lines, " << r.ms << " ms";
+    if(r.ms > 0)
+    {
+        std::cout << " (x" << base / r.ms << ")";
+    }
+    std::cout << "\n";
+}
+
+int main()
+{
+    std::string text = makeText();
+    std::cout << text.size() << " bytes, " << BENCH_ROUNDS << " rounds\n";
+
+    Result base = measure(text, splitFindFirstOf);
+    report("std::find_first_of", base, base.ms);
+    report("readString(string)", measure(text, splitString), base.ms);
+    report("readString(DelimiterSet)", measure(text, splitDelimiterSet), base.ms);
+    return 0;
+}
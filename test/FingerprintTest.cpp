@@ -0,0 +1,76 @@
+//
+//  FingerprintTest.cpp
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+//
+// Known answers of CRC-32 and FINGERPRINT, with the sample messages of RFC 5769
+//
+// g++ -I. -Istun stun/*.cpp test/FingerprintTest.cpp -o fingerprint && ./fingerprint
+//
+
+#include <stun/Message.h>
+#include <stun/Crc32.h>
+#include "Rfc5769.h"
+#include "Check.h"
+#include <vector>
+
+static void testCrc32()
+{
+    const unsigned char check[] = "123456789";
+    CHECK(network::crc32(check, 9) == 0xcbf43926);
+    CHECK(network::crc32(check, 0) == 0);
+    
+    // Continued over parts
+    uint32_t crc = network::crc32(check, 4);
+    CHECK(network::crc32(check + 4, 5, crc) == 0xcbf43926);
+}
+
+static void testSample(const unsigned char* sample, size_t n)
+{
+    CHECK(stun::Message::checkFingerprint(sample, n));
+    
+    // Any changed bit of the message
+    std::vector<unsigned char> m(sample, sample + n);
+    for(size_t i = 0; i < n - 4; i += 7)
+    {
+        m[i] ^= 0x10;
+        CHECK(!stun::Message::checkFingerprint(&m[0], n));
+        m[i] ^= 0x10;
+    }
+    
+    // Not the last attribute
+    CHECK(!stun::Message::checkFingerprint(sample, n - 8));
+    
+    // Kept by decoding, eager and lazy
+    for(int lazy = 0; lazy < 2; ++lazy)
+    {
+        network::BufferView view(sample, n);
+        stun::Message* msg = stun::MessageFactory::fromBuffer(&view, lazy != 0);
+        CHECK(msg != NULL && msg->hasFingerprint());
+        delete msg;
+    }
+}
+
+// A packed message checks with its own FINGERPRINT
+static void testPack()
+{
+    stun::BindingRequest request;
+    request.setFingerprint();
+    unsigned char b[MESSAGE_BUFFER_SIZE];
+    size_t n = request.toBuffer(b, sizeof(b));
+    CHECK(n == MESSAGE_HEADER_LENGTH + ATTRIBUTE_HEADER_LENGTH + 4);
+    CHECK(stun::Message::checkFingerprint(b, n));
+}
+
+int main()
+{
+    testCrc32();
+    testSample(SAMPLE_IPV4_RESPONSE, sizeof(SAMPLE_IPV4_RESPONSE));
+    testSample(SAMPLE_IPV6_RESPONSE, sizeof(SAMPLE_IPV6_RESPONSE));
+    CHECK(stun::Message::checkFingerprint(SAMPLE_REQUEST, sizeof(SAMPLE_REQUEST)));
+    testPack();
+    
+    return checkResult();
+}
@@ -0,0 +1,140 @@
+//
+//  IntegrityTest.cpp
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+//
+// Known answers of MESSAGE-INTEGRITY with short-term and long-term
+// credentials, with the sample messages of RFC 5769
+//
+// g++ -I. -Istun stun/*.cpp test/IntegrityTest.cpp -o integrity && ./integrity
+//
+
+#include <stun/Message.h>
+#include <stun/ParsedMessage.h>
+#include <stun/Credential.h>
+#include <stun/Crc32.h>
+#include "Rfc5769.h"
+#include "Check.h"
+#include <vector>
+
+#define FINGERPRINT_XOR 0x5354554e // "STUN", RFC 5389 15.5
+
+// Memory length of message up to the end of MESSAGE-INTEGRITY
+#define WITHOUT_FINGERPRINT(n) ((n) - ATTRIBUTE_HEADER_LENGTH - 4)
+
+static void testShortTerm(const unsigned char* sample, size_t n)
+{
+    stun::Credential credential("evtj:h6vY", SAMPLE_SHORT_TERM_PASSWORD);
+    stun::Credential wrong("evtj:h6vY", "VOkJxbRl1RmTxUk/WvJxBu");
+    CHECK(stun::Message::checkIntegrity(sample, WITHOUT_FINGERPRINT(n), credential));
+    CHECK(!stun::Message::checkIntegrity(sample, WITHOUT_FINGERPRINT(n), wrong));
+    
+    // Any changed bit before MESSAGE-INTEGRITY
+    std::vector<unsigned char> m(sample, sample + n);
+    for(size_t i = 0; i < WITHOUT_FINGERPRINT(n); i += 5)
+    {
+        m[i] ^= 0x01;
+        CHECK(!stun::Message::checkIntegrity(&m[0], WITHOUT_FINGERPRINT(n), credential));
+        m[i] ^= 0x01;
+    }
+}
+
+// Responses keep the received bytes to check with a credential later
+static void testResponse(const unsigned char* sample, size_t n)
+{
+    stun::Credential credential("evtj:h6vY", SAMPLE_SHORT_TERM_PASSWORD);
+    for(int lazy = 0; lazy < 2; ++lazy)
+    {
+        network::BufferView view(sample, n);
+        stun::Message* msg = stun::MessageFactory::fromBuffer(&view, lazy != 0);
+        CHECK(msg != NULL && msg->checkIntegrity(credential));
+        delete msg;
+    }
+    
+    stun::ParsedMessage parsed;
+    CHECK(parsed.parse(sample, n) && parsed.checkIntegrity(credential));
+}
+
+static void testLongTerm()
+{
+    const unsigned char* sample = SAMPLE_LONG_TERM_REQUEST;
+    size_t n = sizeof(SAMPLE_LONG_TERM_REQUEST);
+    stun::Credential credential(SAMPLE_LONG_TERM_USERNAME, SAMPLE_LONG_TERM_REALM, SAMPLE_LONG_TERM_PASSWORD);
+    CHECK(stun::Message::checkIntegrity(sample, n, credential));
+    
+    // The cached key is not used for a changed password, nor another realm
+    stun::Credential password(SAMPLE_LONG_TERM_USERNAME, SAMPLE_LONG_TERM_REALM, "TheMatrix2");
+    CHECK(!stun::Message::checkIntegrity(sample, n, password));
+    stun::Credential realm(SAMPLE_LONG_TERM_USERNAME, "example.com", SAMPLE_LONG_TERM_PASSWORD);
+    CHECK(!stun::Message::checkIntegrity(sample, n, realm));
+    
+    stun::Credential again(SAMPLE_LONG_TERM_USERNAME, SAMPLE_LONG_TERM_REALM, SAMPLE_LONG_TERM_PASSWORD);
+    CHECK(stun::Message::checkIntegrity(sample, n, again));
+}
+
+// A packed request checks with its own MESSAGE-INTEGRITY
+static void testPack()
+{
+    stun::Credential credential(SAMPLE_LONG_TERM_USERNAME, SAMPLE_LONG_TERM_REALM, SAMPLE_LONG_TERM_PASSWORD);
+    stun::BindingRequest request;
+    request.setMessageIntegrity(credential);
+    request.setFingerprint();
+    unsigned char b[MESSAGE_BUFFER_SIZE];
+    size_t n = request.toBuffer(b, sizeof(b));
+    CHECK(n > 0);
+    CHECK(stun::Message::checkFingerprint(b, n));
+    CHECK(stun::Message::checkIntegrity(b, WITHOUT_FINGERPRINT(n), credential));
+}
+
+// Attributes after MESSAGE-INTEGRITY, but FINGERPRINT, are ignored (RFC 5389 15.4)
+static void testAfterIntegrity()
+{
+    const unsigned char source[] = { 0x00, 0x04, 0x00, 0x08, 0x00, 0x01, 0x0d, 0x96, 10, 0, 0, 1 }; // SOURCE-ADDRESS
+    size_t n = sizeof(SAMPLE_IPV4_RESPONSE);
+    std::vector<unsigned char> m(SAMPLE_IPV4_RESPONSE, SAMPLE_IPV4_RESPONSE + WITHOUT_FINGERPRINT(n));
+    m.insert(m.end(), source, source + sizeof(source));
+    m[3] += sizeof(source);
+    
+    // New FINGERPRINT over the longer message
+    uint32_t crc = network::crc32(&m[0], m.size()) ^ FINGERPRINT_XOR;
+    m.insert(m.end(), SAMPLE_IPV4_RESPONSE + WITHOUT_FINGERPRINT(n), SAMPLE_IPV4_RESPONSE + n);
+    m[m.size() - 4] = static_cast<unsigned char>(crc >> 24);
+    m[m.size() - 3] = static_cast<unsigned char>(crc >> 16);
+    m[m.size() - 2] = static_cast<unsigned char>(crc >> 8);
+    m[m.size() - 1] = static_cast<unsigned char>(crc);
+    CHECK(stun::Message::checkFingerprint(&m[0], m.size()));
+    
+    stun::Credential credential("evtj:h6vY", SAMPLE_SHORT_TERM_PASSWORD);
+    for(int lazy = 0; lazy < 2; ++lazy)
+    {
+        network::BufferView view(&m[0], m.size());
+        stun::Message* msg = stun::MessageFactory::fromBuffer(&view, lazy != 0);
+        CHECK(msg != NULL && msg->hasFingerprint() && msg->checkIntegrity(credential));
+        if(msg != NULL)
+        {
+            sockaddr_in sa = static_cast<stun::BindingResponse*>(msg)->sourceAddress();
+            CHECK(sa.sin_port == 0);
+        }
+        delete msg;
+    }
+    
+    stun::ParsedMessage parsed;
+    sockaddr_in sa;
+    CHECK(parsed.parse(&m[0], m.size()) && !parsed.sourceAddress(&sa));
+}
+
+int main()
+{
+    testShortTerm(SAMPLE_REQUEST, sizeof(SAMPLE_REQUEST));
+    testShortTerm(SAMPLE_IPV4_RESPONSE, sizeof(SAMPLE_IPV4_RESPONSE));
+    testShortTerm(SAMPLE_IPV6_RESPONSE, sizeof(SAMPLE_IPV6_RESPONSE));
+    testResponse(SAMPLE_IPV4_RESPONSE, sizeof(SAMPLE_IPV4_RESPONSE));
+    testResponse(SAMPLE_IPV6_RESPONSE, sizeof(SAMPLE_IPV6_RESPONSE));
+    testLongTerm();
+    testPack();
+    testAfterIntegrity();
+    
+    return checkResult();
+}
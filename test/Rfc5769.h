@@ -0,0 +1,147 @@
+//
+//  Rfc5769.h
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+#ifndef TEST_RFC5769_H
+#define TEST_RFC5769_H
+
+//
+// Sample messages of RFC 5769, Test Vectors for STUN
+//
+
+// 2.1. Sample Request
+// Short-term password "VOkJxbRl1RmTxUk/WvJxBt"
+static const unsigned char SAMPLE_REQUEST[] =
+{
+    0x00, 0x01, 0x00, 0x58, // Request type and message length
+    0x21, 0x12, 0xa4, 0x42, // Magic cookie
+    0xb7, 0xe7, 0xa7, 0x01, // Transaction ID
+    0xbc, 0x34, 0xd6, 0x86,
+    0xfa, 0x87, 0xdf, 0xae,
+    0x80, 0x22, 0x00, 0x10, // SOFTWARE "STUN test client"
+    0x53, 0x54, 0x55, 0x4e,
+    0x20, 0x74, 0x65, 0x73,
+    0x74, 0x20, 0x63, 0x6c,
+    0x69, 0x65, 0x6e, 0x74,
+    0x00, 0x24, 0x00, 0x04, // PRIORITY
+    0x6e, 0x00, 0x01, 0xff,
+    0x80, 0x29, 0x00, 0x08, // ICE-CONTROLLED
+    0x93, 0x2f, 0xf9, 0xb1,
+    0x51, 0x26, 0x3b, 0x36,
+    0x00, 0x06, 0x00, 0x09, // USERNAME "evtj:h6vY", padded with spaces
+    0x65, 0x76, 0x74, 0x6a,
+    0x3a, 0x68, 0x36, 0x76,
+    0x59, 0x20, 0x20, 0x20,
+    0x00, 0x08, 0x00, 0x14, // MESSAGE-INTEGRITY
+    0x9a, 0xea, 0xa7, 0x0c,
+    0xbf, 0xd8, 0xcb, 0x56,
+    0x78, 0x1e, 0xf2, 0xb5,
+    0xb2, 0xd3, 0xf2, 0x49,
+    0xc1, 0xb5, 0x71, 0xa2,
+    0x80, 0x28, 0x00, 0x04, // FINGERPRINT
+    0xe5, 0x7a, 0x3b, 0xcf
+};
+
+// 2.2. Sample IPv4 Response, same password
+// XOR-MAPPED-ADDRESS 192.0.2.1:32853
+static const unsigned char SAMPLE_IPV4_RESPONSE[] =
+{
+    0x01, 0x01, 0x00, 0x3c, // Response type and message length
+    0x21, 0x12, 0xa4, 0x42, // Magic cookie
+    0xb7, 0xe7, 0xa7, 0x01, // Transaction ID
+    0xbc, 0x34, 0xd6, 0x86,
+    0xfa, 0x87, 0xdf, 0xae,
+    0x80, 0x22, 0x00, 0x0b, // SOFTWARE "test vector "
+    0x74, 0x65, 0x73, 0x74,
+    0x20, 0x76, 0x65, 0x63,
+    0x74, 0x6f, 0x72, 0x20,
+    0x00, 0x20, 0x00, 0x08, // XOR-MAPPED-ADDRESS
+    0x00, 0x01, 0xa1, 0x47,
+    0xe1, 0x12, 0xa6, 0x43,
+    0x00, 0x08, 0x00, 0x14, // MESSAGE-INTEGRITY
+    0x2b, 0x91, 0xf5, 0x99,
+    0xfd, 0x9e, 0x90, 0xc3,
+    0x8c, 0x74, 0x89, 0xf9,
+    0x2a, 0xf9, 0xba, 0x53,
+    0xf0, 0x6b, 0xe7, 0xd7,
+    0x80, 0x28, 0x00, 0x04, // FINGERPRINT
+    0xc0, 0x7d, 0x4c, 0x96
+};
+
+// 2.3. Sample IPv6 Response, same password
+// XOR-MAPPED-ADDRESS [2001:db8:1234:5678:11:2233:4455:6677]:32853
+static const unsigned char SAMPLE_IPV6_RESPONSE[] =
+{
+    0x01, 0x01, 0x00, 0x48, // Response type and message length
+    0x21, 0x12, 0xa4, 0x42, // Magic cookie
+    0xb7, 0xe7, 0xa7, 0x01, // Transaction ID
+    0xbc, 0x34, 0xd6, 0x86,
+    0xfa, 0x87, 0xdf, 0xae,
+    0x80, 0x22, 0x00, 0x0b, // SOFTWARE "test vector "
+    0x74, 0x65, 0x73, 0x74,
+    0x20, 0x76, 0x65, 0x63,
+    0x74, 0x6f, 0x72, 0x20,
+    0x00, 0x20, 0x00, 0x14, // XOR-MAPPED-ADDRESS
+    0x00, 0x02, 0xa1, 0x47,
+    0x01, 0x13, 0xa9, 0xfa,
+    0xa5, 0xd3, 0xf1, 0x79,
+    0xbc, 0x25, 0xf4, 0xb5,
+    0xbe, 0xd2, 0xb9, 0xd9,
+    0x00, 0x08, 0x00, 0x14, // MESSAGE-INTEGRITY
+    0xa3, 0x82, 0x95, 0x4e,
+    0x4b, 0xe6, 0x7b, 0xf1,
+    0x17, 0x84, 0xc9, 0x7c,
+    0x82, 0x92, 0xc2, 0x75,
+    0xbf, 0xe3, 0xed, 0x41,
+    0x80, 0x28, 0x00, 0x04, // FINGERPRINT
+    0xc8, 0xfb, 0x0b, 0x4c
+};
+
+#define SAMPLE_SHORT_TERM_PASSWORD "VOkJxbRl1RmTxUk/WvJxBt"
+
+// 2.4. Sample Request with Long-Term Authentication
+// MESSAGE-INTEGRITY is HMAC-SHA1 with key MD5(username ":" realm ":" password)
+// of the values below, as computed by Python's hashlib and hmac
+static const unsigned char SAMPLE_LONG_TERM_REQUEST[] =
+{
+    0x00, 0x01, 0x00, 0x60, // Request type and message length
+    0x21, 0x12, 0xa4, 0x42, // Magic cookie
+    0x78, 0xad, 0x34, 0x33, // Transaction ID
+    0xc6, 0xad, 0x72, 0xc0,
+    0x29, 0xda, 0x41, 0x2e,
+    0x00, 0x06, 0x00, 0x12, // USERNAME, 18 bytes and padding
+    0xe3, 0x83, 0x9e, 0xe3,
+    0x83, 0x88, 0xe3, 0x83,
+    0xaa, 0xe3, 0x83, 0x83,
+    0xe3, 0x82, 0xaf, 0xe3,
+    0x82, 0xb9, 0x00, 0x00,
+    0x00, 0x15, 0x00, 0x1c, // NONCE
+    0x66, 0x2f, 0x2f, 0x34,
+    0x39, 0x39, 0x6b, 0x39,
+    0x35, 0x34, 0x64, 0x36,
+    0x4f, 0x4c, 0x33, 0x34,
+    0x6f, 0x4c, 0x39, 0x46,
+    0x53, 0x54, 0x76, 0x79,
+    0x36, 0x34, 0x73, 0x41,
+    0x00, 0x14, 0x00, 0x0b, // REALM "example.org" and padding
+    0x65, 0x78, 0x61, 0x6d,
+    0x70, 0x6c, 0x65, 0x2e,
+    0x6f, 0x72, 0x67, 0x00,
+    0x00, 0x08, 0x00, 0x14, // MESSAGE-INTEGRITY
+    0x27, 0x26, 0x4c, 0xa4,
+    0xb8, 0xae, 0x75, 0x1f,
+    0x1d, 0xf3, 0xab, 0xec,
+    0xb1, 0x55, 0xda, 0x12,
+    0x45, 0x23, 0x35, 0x5c
+};
+
+// U+30DE U+30C8 U+30EA U+30C3 U+30AF U+30B9 in UTF-8
+#define SAMPLE_LONG_TERM_USERNAME "\xe3\x83\x9e\xe3\x83\x88\xe3\x83\xaa\xe3\x83\x83\xe3\x82\xaf\xe3\x82\xb9"
+#define SAMPLE_LONG_TERM_REALM "example.org"
+
+// "The<U+00AD>M<U+00AA>trix" after SASLprep
+#define SAMPLE_LONG_TERM_PASSWORD "TheMatrix"
+
+#endif
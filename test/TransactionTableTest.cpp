@@ -0,0 +1,190 @@
+//
+//  TransactionTableTest.cpp
+//
+//  Copyright (c) 2012 LIM Labs. All rights reserved.
+//
+
+//
+// Probe chains, backward-shift removal, growth and raw ID lookups of
+// TransactionTable
+//
+// g++ -I. -Istun stun/*.cpp test/TransactionTableTest.cpp -o transactions && ./transactions
+//
+
+#include <stun/TransactionTable.h>
+#include <stun/Random.h>
+#include "Check.h"
+#include <vector>
+#include <cstring>
+
+static network::UUID randomTid()
+{
+    unsigned char b[16];
+    network::Random::local().bytes(b, sizeof(b));
+    return network::UUID(b, sizeof(b));
+}
+
+// IDs that differ but fold to the same key, so share a home slot
+static network::UUID collidingTid(const network::UUID& tid, unsigned char d)
+{
+    unsigned char b[16];
+    memcpy(b, tid.bytes(), sizeof(b));
+    b[0] ^= d;
+    b[8] ^= d;
+    return network::UUID(b, sizeof(b));
+}
+
+// Every ID of the table is found at its own slot, and size agrees
+static bool consistent(const stun::TransactionTable& table, const std::vector<network::UUID>& tids)
+{
+    for(size_t i = 0; i < tids.size(); ++i)
+    {
+        stun::Transaction* t = table.find(tids[i]);
+        if(t == NULL || memcmp(t->tid, tids[i].bytes(), 16) != 0)
+        {
+            return false;
+        }
+    }
+    return table.size() == tids.size();
+}
+
+// Removing from the head, middle and tail of one probe chain
+static void testChain()
+{
+    for(size_t removed = 0; removed < 5; ++removed)
+    {
+        stun::TransactionTable table(16);
+        network::UUID base = randomTid();
+        std::vector<network::UUID> tids;
+        for(unsigned char d = 0; d < 5; ++d)
+        {
+            tids.push_back(collidingTid(base, d));
+            CHECK(table.insert(tids.back()) != NULL);
+        }
+        CHECK(consistent(table, tids));
+        
+        CHECK(table.remove(tids[removed]));
+        CHECK(table.find(tids[removed]) == NULL);
+        CHECK(!table.remove(tids[removed]));
+        network::UUID gone = tids[removed];
+        tids.erase(tids.begin() + removed);
+        CHECK(consistent(table, tids));
+        
+        // The freed slot is used again
+        CHECK(table.insert(gone) != NULL);
+        tids.push_back(gone);
+        CHECK(consistent(table, tids));
+    }
+}
+
+// Random inserts and removals against a plain list
+static void testRandom()
+{
+    stun::TransactionTable table(8);
+    std::vector<network::UUID> tids;
+    network::Random& random = network::Random::local();
+    for(size_t i = 0; i < 5000; ++i)
+    {
+        if(tids.empty() || random.next64() % 3 != 0)
+        {
+            // Colliding IDs now and then, for long chains
+            network::UUID tid = tids.empty() || random.next64() % 4 != 0
+                ? randomTid() : collidingTid(tids[random.next64() % tids.size()], static_cast<unsigned char>(1 + i % 255));
+            if(table.insert(tid) != NULL)
+            {
+                tids.push_back(tid);
+            }
+        }
+        else
+        {
+            size_t k = random.next64() % tids.size();
+            stun::Transaction* t = table.find(tids[k]);
+            CHECK(t != NULL);
+            if(t != NULL)
+            {
+                table.remove(t);
+            }
+            tids.erase(tids.begin() + k);
+        }
+        
+        if(i % 100 == 0)
+        {
+            CHECK(consistent(table, tids));
+        }
+    }
+    CHECK(consistent(table, tids));
+}
+
+// Doubles when half full, and keeps every transaction
+static void testGrowth()
+{
+    stun::TransactionTable table(4);
+    std::vector<network::UUID> tids;
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        tids.push_back(randomTid());
+        stun::Transaction* t = table.insert(tids.back(), reinterpret_cast<void*>(i + 1));
+        CHECK(t != NULL);
+        if(t != NULL)
+        {
+            t->send(static_cast<int64_t>(i + 1));
+        }
+        CHECK(table.size() * 2 <= table.capacity());
+    }
+    CHECK(table.capacity() == 2048);
+    CHECK(consistent(table, tids));
+    
+    // Fields move with the slots
+    for(size_t i = 0; i < tids.size(); ++i)
+    {
+        stun::Transaction* t = table.find(tids[i]);
+        CHECK(t != NULL && t->context == reinterpret_cast<void*>(i + 1) && t->sent == static_cast<int64_t>(i + 1));
+    }
+    
+    // An ID in the table already
+    CHECK(table.insert(tids[0]) == NULL);
+    
+    table.clear();
+    CHECK(table.size() == 0 && table.find(tids[0]) == NULL);
+}
+
+// The raw form reads the ID in place, at any alignment
+static void testRawFind()
+{
+    stun::TransactionTable table;
+    network::UUID tid = randomTid();
+    stun::Transaction* t = table.insert(tid);
+    
+    unsigned char datagram[1 + 20];
+    memset(datagram, 0, sizeof(datagram));
+    memcpy(datagram + 1 + 4, tid.bytes(), 16);
+    CHECK(table.find(datagram + 1 + 4) == t);
+    
+    datagram[1 + 4 + 15] ^= 0x01;
+    CHECK(table.find(datagram + 1 + 4) == NULL);
+    
+    // Same folded key, other ID
+    network::UUID other = collidingTid(tid, 0x80);
+    CHECK(table.find(other.bytes()) == NULL);
+}
+
+static void testSend()
+{
+    stun::Transaction t;
+    memset(&t, 0, sizeof(t));
+    t.send(100);
+    t.send(300);
+    t.send(700);
+    CHECK(t.sent == 100 && t.resent == 700 && t.retransmits == 2);
+}
+
+int main()
+{
+    testChain();
+    testRandom();
+    testGrowth();
+    testRawFind();
+    testSend();
+    
+    return checkResult();
+}